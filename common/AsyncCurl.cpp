@@ -0,0 +1,348 @@
+/*************************************************************************
+    > File Name: AsyncCurl.cpp
+    > Author: Jun Zhang
+    > Mail: ewalker.zj@gmail.com
+    > Created Time: Sat 17 Oct 2026 10:13:05 AM CST
+ ************************************************************************/
+
+#include <memory>
+#include <cassert>
+
+#include "AsyncCurl.h"
+#include "CurlContext.h"
+
+static size_t WriteCallback(void *content, size_t size, size_t nmemb, void *userp){
+    size_t n = size * nmemb;
+    return ((const CurlSink*)userp) -> Write((const char*)content, n) ? n : 0;
+}
+
+AsyncCurl::AsyncCurl(size_t maxInFlight, long defaultTimeoutMs, CurlContext *ctx)
+    : maxInFlight(maxInFlight ? maxInFlight : 1), defaultTimeoutMs(defaultTimeoutMs), ctx(ctx),
+      http2(HTTP2_OFF), maxStreams(100), maxHostConnections(0), timings(NULL), multi(NULL), running(false), stopping(false), joining(false), nextId(1), woken(false), pending(0){
+}
+
+AsyncCurl::~AsyncCurl(){
+    assert(std::this_thread::get_id() != loop.get_id());
+    Stop();
+}
+
+void AsyncCurl::SetHttp2(Http2Mode mode, long maxStreams, long maxHostConnections){
+    std::unique_lock<std::mutex> lock(mutex);
+    http2 = mode;
+    this -> maxStreams = maxStreams > 0 ? maxStreams : 1;
+    this -> maxHostConnections = maxHostConnections > 0 ? maxHostConnections : 0;
+}
+
+void AsyncCurl::SetTimings(CurlTimings *timings){
+    std::unique_lock<std::mutex> lock(mutex);
+    this -> timings = timings;
+}
+
+bool AsyncCurl::Start(){
+    std::unique_lock<std::mutex> lock(mutex);
+    // still winding down after a Stop from the loop thread, nothing can be restarted yet
+    if(running)
+        return !stopping;
+    CurlContext::GlobalInit();
+    multi = curl_multi_init();
+    if(multi == NULL)
+        return false;
+    if(http2 != HTTP2_OFF){
+        curl_multi_setopt(multi, CURLMOPT_PIPELINING, CURLPIPE_MULTIPLEX);
+        curl_multi_setopt(multi, CURLMOPT_MAX_CONCURRENT_STREAMS, maxStreams);
+    }
+    if(maxHostConnections)
+        curl_multi_setopt(multi, CURLMOPT_MAX_HOST_CONNECTIONS, maxHostConnections);
+    stopping = false;
+    woken = false;
+    running = true;
+    loop = std::thread(&AsyncCurl::Loop, this);
+    return true;
+}
+
+void AsyncCurl::Stop(){
+    std::unique_lock<std::mutex> lock(mutex);
+    if(!running)
+        return;
+    if(!stopping){
+        stopping = true;
+        curl_multi_wakeup(multi);
+    }
+    // from a callback or a scheduled fn: the loop winds down once it returns,
+    // a later Stop or the destructor on another thread joins it
+    if(std::this_thread::get_id() == loop.get_id())
+        return;
+    // only one caller joins, the others wait until it is done
+    if(joining){
+        stopped.wait(lock, [this](){ return !running; });
+        return;
+    }
+    joining = true;
+    lock.unlock();
+    loop.join();
+    lock.lock();
+    curl_multi_cleanup(multi);
+    multi = NULL;
+    running = false;
+    joining = false;
+    stopped.notify_all();
+}
+
+uint64_t AsyncCurl::Submit(AsyncRequest req, AsyncCallback cb){
+    Transfer *t = new Transfer();
+    t -> req = std::move(req);
+    t -> cb = std::move(cb);
+    if(t -> req.onChunk)
+        t -> sink = CurlSink(t -> req.onChunk);
+    else
+        t -> sink = CurlSink(&t -> resp.body);
+    t -> easy = NULL;
+    t -> headers = NULL;
+    t -> error[0] = 0;
+
+    std::unique_lock<std::mutex> lock(mutex);
+    if(!running || stopping){
+        delete t;
+        return 0;
+    }
+    t -> id = nextId++;
+    submitted.push_back(t);
+    pending.fetch_add(1, std::memory_order_relaxed);
+    Wake();
+    return t -> id;
+}
+
+void AsyncCurl::Cancel(uint64_t id){
+    std::unique_lock<std::mutex> lock(mutex);
+    if(!running || stopping)
+        return;
+    cancelled.push_back(id);
+    Wake();
+}
+
+bool AsyncCurl::Schedule(long delayMs, std::function<void()> fn){
+    std::unique_lock<std::mutex> lock(mutex);
+    if(!running || stopping)
+        return false;
+    scheduled.push_back(std::make_pair(std::chrono::steady_clock::now() + std::chrono::milliseconds(delayMs), std::move(fn)));
+    Wake();
+    return true;
+}
+
+// caller holds mutex. only the first request of a batch has to interrupt curl_multi_poll
+void AsyncCurl::Wake(){
+    if(!woken){
+        woken = true;
+        curl_multi_wakeup(multi);
+    }
+}
+
+std::future<AsyncResponse> AsyncCurl::Submit(AsyncRequest req){
+    std::shared_ptr<std::promise<AsyncResponse> > p = std::make_shared<std::promise<AsyncResponse> >();
+    std::future<AsyncResponse> f = p -> get_future();
+    if(Submit(std::move(req), [p](AsyncResponse &resp){ p -> set_value(std::move(resp)); }) == 0){
+        AsyncResponse resp;
+        resp.code = CURLE_FAILED_INIT;
+        resp.error = "client not running";
+        p -> set_value(std::move(resp));
+    }
+    return f;
+}
+
+void AsyncCurl::StartTransfer(Transfer *t){
+    CURL *easy = NULL;
+    if(!freeHandles.empty()){
+        easy = freeHandles.back();
+        freeHandles.pop_back();
+        curl_easy_reset(easy);
+    } else {
+        easy = curl_easy_init();
+    }
+    if(easy == NULL){
+        t -> resp.code = CURLE_FAILED_INIT;
+        Complete(t);
+        return;
+    }
+    t -> easy = easy;
+
+    curl_easy_setopt(easy, CURLOPT_URL, t -> req.url.c_str());
+    curl_easy_setopt(easy, CURLOPT_WRITEFUNCTION, WriteCallback);
+    curl_easy_setopt(easy, CURLOPT_WRITEDATA, &t -> sink);
+    curl_easy_setopt(easy, CURLOPT_ERRORBUFFER, t -> error);
+    curl_easy_setopt(easy, CURLOPT_PRIVATE, t);
+    curl_easy_setopt(easy, CURLOPT_NOSIGNAL, 1L);
+    if(ctx)
+        ctx -> Attach(easy);
+    if(http2 != HTTP2_OFF){
+        curl_easy_setopt(easy, CURLOPT_HTTP_VERSION,
+                http2 == HTTP2_TLS ? CURL_HTTP_VERSION_2TLS : CURL_HTTP_VERSION_2_PRIOR_KNOWLEDGE);
+        // wait for a connection that is still being set up rather than open another one,
+        // so a burst to a cold host multiplexes instead of racing handshakes
+        curl_easy_setopt(easy, CURLOPT_PIPEWAIT, 1L);
+    }
+    curl_easy_setopt(easy, CURLOPT_TIMEOUT_MS, t -> req.timeoutMs > 0 ? t -> req.timeoutMs : defaultTimeoutMs);
+    if(!t -> req.body.empty()){
+        curl_easy_setopt(easy, CURLOPT_POSTFIELDS, t -> req.body.c_str());
+        // for large content
+        curl_easy_setopt(easy, CURLOPT_POSTFIELDSIZE_LARGE, (curl_off_t)t -> req.body.size());
+    }
+    for(auto &it : t -> req.headers){
+        curl_slist *temp = curl_slist_append(t -> headers, it.c_str());
+        if(temp == NULL)
+            break;
+        t -> headers = temp;
+    }
+    if(t -> headers)
+        curl_easy_setopt(easy, CURLOPT_HTTPHEADER, t -> headers);
+
+    CURLMcode mc = curl_multi_add_handle(multi, easy);
+    if(mc != CURLM_OK){
+        t -> resp.code = CURLE_FAILED_INIT;
+        t -> resp.error = curl_multi_strerror(mc);
+        freeHandles.push_back(easy);
+        t -> easy = NULL;
+        Complete(t);
+        return;
+    }
+    active[easy] = t;
+}
+
+void AsyncCurl::FinishTransfer(Transfer *t, CURLcode code){
+    curl_multi_remove_handle(multi, t -> easy);
+    active.erase(t -> easy);
+    t -> resp.code = code;
+    curl_easy_getinfo(t -> easy, CURLINFO_RESPONSE_CODE, &t -> resp.status);
+    curl_easy_getinfo(t -> easy, CURLINFO_HTTP_VERSION, &t -> resp.httpVersion);
+    curl_easy_getinfo(t -> easy, CURLINFO_NUM_CONNECTS, &t -> resp.connects);
+    if(code != CURLE_OK)
+        t -> resp.error = t -> error[0] ? t -> error : curl_easy_strerror(code);
+    if(timings)
+        timings -> Record(t -> req.url, t -> easy, code);
+    // keep the handle, its buffers and connection data are reused by the next transfer
+    freeHandles.push_back(t -> easy);
+    t -> easy = NULL;
+    Complete(t);
+}
+
+void AsyncCurl::Abort(Transfer *t, const char *why){
+    if(t -> easy){
+        curl_multi_remove_handle(multi, t -> easy);
+        active.erase(t -> easy);
+        freeHandles.push_back(t -> easy);
+        t -> easy = NULL;
+    } else {
+        for(auto it = waiting.begin(); it != waiting.end(); ++it){
+            if(*it == t){
+                waiting.erase(it);
+                break;
+            }
+        }
+    }
+    t -> resp.code = CURLE_ABORTED_BY_CALLBACK;
+    t -> resp.error = why;
+    Complete(t);
+}
+
+void AsyncCurl::Complete(Transfer *t){
+    byId.erase(t -> id);
+    curl_slist_free_all(t -> headers);
+    t -> headers = NULL;
+    pending.fetch_sub(1, std::memory_order_relaxed);
+    if(t -> cb)
+        t -> cb(t -> resp);
+    delete t;
+}
+
+void AsyncCurl::Loop(){
+    typedef std::chrono::steady_clock clock;
+    std::vector<Transfer *> incoming;
+    std::vector<uint64_t> cancels;
+    std::vector<std::pair<clock::time_point, std::function<void()> > > newTimers;
+    while(true){
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            if(stopping)
+                break;
+            incoming.swap(submitted);
+            cancels.swap(cancelled);
+            newTimers.swap(scheduled);
+            woken = false;
+        }
+        for(auto t : incoming){
+            waiting.push_back(t);
+            byId[t -> id] = t;
+        }
+        incoming.clear();
+        for(auto &it : newTimers)
+            timers.insert(std::make_pair(it.first, std::move(it.second)));
+        newTimers.clear();
+        for(auto id : cancels){
+            auto it = byId.find(id);
+            if(it != byId.end())
+                Abort(it -> second, "cancelled");
+        }
+        cancels.clear();
+
+        clock::time_point now = clock::now();
+        while(!timers.empty() && timers.begin() -> first <= now){
+            std::function<void()> fn = std::move(timers.begin() -> second);
+            timers.erase(timers.begin());
+            fn();
+        }
+
+        while(active.size() < maxInFlight && !waiting.empty()){
+            Transfer *t = waiting.front();
+            waiting.pop_front();
+            StartTransfer(t);
+        }
+
+        int still = 0;
+        curl_multi_perform(multi, &still);
+
+        CURLMsg *msg = NULL;
+        int left = 0;
+        while((msg = curl_multi_info_read(multi, &left))){
+            if(msg -> msg != CURLMSG_DONE)
+                continue;
+            Transfer *t = NULL;
+            curl_easy_getinfo(msg -> easy_handle, CURLINFO_PRIVATE, (char **)&t);
+            FinishTransfer(t, msg -> data.result);
+        }
+
+        // finished transfers may have freed room for waiting ones, go round again without sleeping
+        if(!waiting.empty() && active.size() < maxInFlight)
+            continue;
+        int wait = 1000;
+        if(!timers.empty()){
+            long long due = std::chrono::duration_cast<std::chrono::milliseconds>(timers.begin() -> first - clock::now()).count();
+            wait = due <= 0 ? 0 : (due < wait ? (int)due + 1 : wait);
+        }
+        curl_multi_poll(multi, NULL, 0, wait, NULL);
+    }
+
+    // stopping: timers run now, whatever they submit is refused, then fail everything that did not complete
+    {
+        std::unique_lock<std::mutex> lock(mutex);
+        newTimers.swap(scheduled);
+    }
+    for(auto &it : newTimers)
+        timers.insert(std::make_pair(it.first, std::move(it.second)));
+    for(auto &it : timers)
+        it.second();
+    timers.clear();
+    {
+        std::unique_lock<std::mutex> lock(mutex);
+        incoming.swap(submitted);
+    }
+    for(auto t : incoming){
+        waiting.push_back(t);
+        byId[t -> id] = t;
+    }
+    while(!active.empty())
+        Abort(active.begin() -> second, "client stopped");
+    while(!waiting.empty())
+        Abort(waiting.front(), "client stopped");
+    for(auto easy : freeHandles)
+        curl_easy_cleanup(easy);
+    freeHandles.clear();
+}
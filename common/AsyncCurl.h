@@ -0,0 +1,155 @@
+/*************************************************************************
+    > File Name: AsyncCurl.h
+    > Author: Jun Zhang
+    > Mail: ewalker.zj@gmail.com
+    > Created Time: Sat 17 Oct 2026 10:12:40 AM CST
+ ************************************************************************/
+
+#pragma once
+
+#include <string>
+#include <vector>
+#include <deque>
+#include <mutex>
+#include <thread>
+#include <future>
+#include <condition_variable>
+#include <atomic>
+#include <functional>
+#include <unordered_map>
+#include <map>
+#include <chrono>
+#include <cstdint>
+
+#include <curl/curl.h>
+
+#include "Curl.h"
+#include "CurlTimings.h"
+
+class CurlContext;
+
+struct AsyncRequest {
+    std::string url;
+    //sent as a POST when non-empty, GET otherwise
+    std::string body;
+    std::vector<std::string> headers;
+    //whole transfer timeout in ms, 0 takes the client default
+    long timeoutMs;
+    //when set the response is streamed here on the loop thread and AsyncResponse.body stays empty
+    ChunkHandler onChunk;
+
+    AsyncRequest() : timeoutMs(0) {}
+};
+
+struct AsyncResponse {
+    CURLcode code;
+    long status;
+    std::string body;
+    std::string error;
+    //CURL_HTTP_VERSION_1_1, CURL_HTTP_VERSION_2_0, ... of the response
+    long httpVersion;
+    //connections the transfer had to open, 0 when it went out on a reused one
+    long connects;
+
+    AsyncResponse() : code(CURLE_OK), status(0), httpVersion(0), connects(0) {}
+    bool Ok() const { return code == CURLE_OK; }
+};
+
+typedef std::function<void(AsyncResponse &)> AsyncCallback;
+
+enum Http2Mode {
+    HTTP2_OFF,              //HTTP/1.1, a connection per concurrent request
+    HTTP2_TLS,              //h2 negotiated over https, HTTP/1.1 for plain http
+    HTTP2_PRIOR_KNOWLEDGE,  //h2c straight away without upgrade, for plain text local stand-ins
+};
+
+//many requests in flight on one curl multi handle driven by a single event loop thread.
+//Submit never blocks on the network, the callback runs on the loop thread once the
+//transfer finishes, fails or times out, so keep it short and hand heavy work elsewhere.
+class AsyncCurl {
+    public :
+        //at most maxInFlight transfers run at once, the rest wait in submit order.
+        //with a context the transfers share its DNS and TLS session caches
+        explicit AsyncCurl(size_t maxInFlight = 256, long defaultTimeoutMs = 5000, CurlContext *ctx = NULL);
+        //must not run on the loop thread, i.e. inside a callback or a scheduled fn
+        ~AsyncCurl();
+
+        //before Start. concurrent requests to one host become streams on a shared
+        //connection, at most maxStreams per connection. maxHostConnections caps the
+        //connections per host (0 = no cap), new requests then queue for a free stream
+        void SetHttp2(Http2Mode mode, long maxStreams = 100, long maxHostConnections = 0);
+        //before Start. every finished transfer is recorded into timings on the loop thread,
+        //cancelled ones are not. timings must outlive the client
+        void SetTimings(CurlTimings *timings);
+
+        bool Start();
+        //fails every request that has not completed with CURLE_ABORTED_BY_CALLBACK.
+        //safe from any thread and from a callback, which only starts the shutdown:
+        //the loop thread is joined by the next Stop or the destructor elsewhere
+        void Stop();
+
+        //returns an id > 0, or 0 when the client is not running
+        uint64_t Submit(AsyncRequest req, AsyncCallback cb);
+        std::future<AsyncResponse> Submit(AsyncRequest req);
+
+        //abort a submitted request, its callback still runs once with CURLE_ABORTED_BY_CALLBACK.
+        //ids that already completed are ignored
+        void Cancel(uint64_t id);
+        //run fn on the loop thread after delayMs. during Stop every pending fn runs right away,
+        //false when the client is not running and fn will never run
+        bool Schedule(long delayMs, std::function<void()> fn);
+
+        //submitted and not yet completed
+        size_t Pending() const { return pending.load(std::memory_order_relaxed); }
+
+    private:
+        struct Transfer {
+            uint64_t id;
+            AsyncRequest req;
+            AsyncCallback cb;
+            AsyncResponse resp;
+            CurlSink sink;
+            CURL *easy;
+            curl_slist *headers;
+            char error[CURL_ERROR_SIZE];
+        };
+
+        AsyncCurl(const AsyncCurl &) = delete;
+        AsyncCurl &operator=(const AsyncCurl &) = delete;
+
+        void Loop();
+        void StartTransfer(Transfer *t);
+        void FinishTransfer(Transfer *t, CURLcode code);
+        void Complete(Transfer *t);
+        void Abort(Transfer *t, const char *why);
+        void Wake();
+
+        const size_t maxInFlight;
+        const long defaultTimeoutMs;
+        CurlContext *ctx;
+        Http2Mode http2;
+        long maxStreams;
+        long maxHostConnections;
+        CurlTimings *timings;
+
+        CURLM *multi;
+        std::thread loop;
+        std::mutex mutex;
+        bool running;
+        bool stopping;
+        bool joining;
+        std::condition_variable stopped;
+        uint64_t nextId;
+        std::vector<Transfer *> submitted;    //guarded by mutex, handed to the loop in batches
+        std::vector<uint64_t> cancelled;
+        std::vector<std::pair<std::chrono::steady_clock::time_point, std::function<void()> > > scheduled;
+        bool woken;
+        std::atomic<size_t> pending;
+
+        //loop thread only
+        std::deque<Transfer *> waiting;
+        std::unordered_map<CURL *, Transfer *> active;
+        std::unordered_map<uint64_t, Transfer *> byId;
+        std::multimap<std::chrono::steady_clock::time_point, std::function<void()> > timers;
+        std::vector<CURL *> freeHandles;
+};
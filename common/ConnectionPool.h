@@ -5,114 +5,828 @@
 #define __TML_CONNECTION_POOL_INC__
 
 #include <queue>
-#include <set>
+#include <vector>
+#include <random>
+#include <cstdint>
+#include <functional>
 #include <thread>
 #include <mutex>
 #include <chrono>
 #include <condition_variable>
 
+#include "coro.h"
+#include "pool_stats.h"
+
 namespace common {
-template<typename T>
+template<typename T, typename Stats = no_pool_stats>
 class connection_pool {
 public:
+    typedef std::chrono::steady_clock clock;
+    
+    //a borrowed connection. goes back to the pool when destroyed,
+    //call mark_invalid() instead when the connection turned out broken
+    class lease {
+    public:
+        lease() : pool(NULL), index(0), conn(NULL) {
+        }
+    
+        lease(lease &&o) : pool(o.pool), index(o.index), conn(o.conn) {
+            o.pool = NULL;
+            o.conn = NULL;
+        }
+    
+        lease &operator=(lease &&o) {
+            if (this != &o) {
+                release();
+                pool = o.pool;
+                index = o.index;
+                conn = o.conn;
+                o.pool = NULL;
+                o.conn = NULL;
+            }
+            return *this;
+        }
+    
+        lease(const lease &) = delete;
+        lease &operator=(const lease &) = delete;
+    
+        ~lease() {
+            release();
+        }
+    
+        T* get() const {
+            return conn;
+        }
+    
+        T* operator->() const {
+            return conn;
+        }
+    
+        T& operator*() const {
+            return *conn;
+        }
+    
+        //false when get() timed out
+        explicit operator bool() const {
+            return conn != NULL;
+        }
+    
+        //put the connection back to pool now
+        void release() {
+            if (pool) {
+                pool->put_back(index);
+                pool = NULL;
+                conn = NULL;
+            }
+        }
+    
+        //hand the connection to the reconnect thread instead of back to idle.
+        //without auto reconnect it leaves the pool, closed and replaced if the factory made it
+        void mark_invalid() {
+            if (pool) {
+                pool->mark_invalid(index);
+                pool = NULL;
+                conn = NULL;
+            }
+        }
+    
+    private:
+        friend class connection_pool;
+        lease(connection_pool *pool, uint32_t index, T *conn) : pool(pool), index(index), conn(conn) {
+        }
+    
+        connection_pool *pool;
+        uint32_t index;
+        T *conn;
+    };
+    
     //auto_reconnect default true if you don't want auto connect, pass false
-    connection_pool(bool auto_reconnect = true) {
+    connection_pool(bool auto_reconnect = true) : idle_head(NIL), idle_tail(NIL), free_head(NIL),
+        wait_head(NULL), wait_tail(NULL), fair(false), auto_reconnect(auto_reconnect), stopping(false),
+        backoff_min(100), backoff_max(30000), reconnect_limit(5), probe_interval(0), next_probe(clock::time_point::max()),
+        next_refill(clock::time_point::max()), rng(std::random_device()()), total(0), creating(0), min_size(0), max_size(0), idle_ttl(0),
+        idle_count(0), in_use_count(0), waiting(0) {
         if (auto_reconnect) {
-            std::thread(std::bind(reconnect, this));
+            reconnector = std::thread(&connection_pool::reconnect, this);
+        }
+    }
+    
+    connection_pool(const connection_pool &) = delete;
+    connection_pool &operator=(const connection_pool &) = delete;
+    
+    //connections created by the factory are destroyed with the pool,
+    //ones that were add-ed by hand stay owned by the caller.
+    //every lease must be released before the pool goes away
+    ~connection_pool() {
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            stopping = true;
+            bad_cond.notify_all();
+        }
+        if (reconnector.joinable()) {
+            reconnector.join();
+        }
+        if (destroy) {
+            for (size_t i = 0; i < slots.size(); i++) {
+                if (slots[i].state != SLOT_FREE && slots[i].owned) {
+                    destroy(slots[i].conn);
+                }
+            }
+        }
+    }
+    
+    //let the pool open connections itself. factory returns NULL on failure,
+    //destroy closes a connection the pool evicts (plain delete by default)
+    void set_factory(std::function<T *()> factory, std::function<void(T *)> destroy = nullptr) {
+        std::unique_lock<std::mutex> lock(mutex);
+        this->factory = factory;
+        this->destroy = destroy ? destroy : [](T *conn) { delete conn; };
+    }
+    
+    //with a factory, get() opens a new connection whenever none is idle and fewer
+    //than max exist (0 = no limit). idle eviction never goes below min
+    void set_limits(size_t min, size_t max) {
+        std::unique_lock<std::mutex> lock(mutex);
+        min_size = min;
+        max_size = max && max < min ? min : max;
+        if (max_size) {
+            slots.reserve(max_size);
+        }
+    }
+    
+    //close factory-made connections that sat idle longer than ttl_ms, down to min
+    void set_idle_ttl(int ttl_ms) {
+        std::unique_lock<std::mutex> lock(mutex);
+        idle_ttl = ttl_ms > 0 ? ttl_ms : 0;
+        ensure_maintenance();
+        bad_cond.notify_all();
+    }
+    
+    //open connections with the factory until the pool holds min,
+    //returns false if the factory failed on the way
+    bool prewarm() {
+        std::unique_lock<std::mutex> lock(mutex);
+        while (factory && total < min_size) {
+            uint32_t i = create(lock);
+            if (i == NIL) {
+                return false;
+            }
+            release_idle(i);
         }
+        return true;
+    }
+    
+    //every connection the pool knows about: idle, in use, being reconnected or probed
+    size_t size() {
+        std::unique_lock<std::mutex> lock(mutex);
+        return total;
+    }
+    
+    //a failed reconnect is retried after a delay that doubles per attempt from
+    //min_ms up to max_ms, with +-50% jitter so a recovering backend isn't hit in lockstep.
+    //a factory-made connection that failed max_attempts reconnects is closed and its
+    //slot handed back to the factory (0 = keep retrying), hand-added ones retry forever
+    void set_reconnect_backoff(int min_ms, int max_ms, int max_attempts = 5) {
+        std::unique_lock<std::mutex> lock(mutex);
+        backoff_min = min_ms > 0 ? min_ms : 1;
+        backoff_max = max_ms > backoff_min ? max_ms : backoff_min;
+        reconnect_limit = max_attempts > 0 ? max_attempts : 0;
+    }
+    
+    //every interval_ms the reconnect thread takes connections that have been idle
+    //at least that long out of the pool and runs probe on them. a failed probe sends
+    //the connection to the reconnect path instead of handing it to the next get
+    void set_health_probe(std::function<bool(T *)> probe, int interval_ms) {
+        std::unique_lock<std::mutex> lock(mutex);
+        health_probe = probe;
+        probe_interval = probe && interval_ms > 0 ? interval_ms : 0;
+        next_probe = probe_interval ? clock::now() + std::chrono::milliseconds(probe_interval) : clock::time_point::max();
+        ensure_maintenance();
+        bad_cond.notify_all();
+    }
+    
+    //fair mode queues every get() and async_acquire() that finds nothing idle, and a
+    //returned connection goes straight to the oldest one. new callers can't barge
+    //past the queue, which trades a little throughput for a much shorter tail
+    void set_fair(bool on) {
+        std::unique_lock<std::mutex> lock(mutex);
+        fair = on;
     }
     
     //add a connection to pool
     bool add(T *conn) {
         //std::scoped_lock lock(mutex);
         std::unique_lock<std::mutex> lock(mutex);
-        idle.push(conn);
-        cond.notify_one();
+        release_idle(new_slot(conn, false));
         return true;
     }
     
-    //get a connection from pool
-    T* get(int timeout = 0) {
+    typedef typename Stats::snapshot stats_snapshot;
+    
+    //pool_stats counters and histograms only
+    Stats &stats() {
+        return counters;
+    }
+    
+    //Stats::snapshot with the connection counts filled in, one short lock
+    stats_snapshot snap() {
+        stats_snapshot s = counters.snap();
+        std::unique_lock<std::mutex> lock(mutex);
+        s.total = total;
+        s.idle = idle_count;
+        s.in_use = in_use_count;
+        s.bad = bad.size();
+        s.waiting = waiting;
+        return s;
+    }
+    
+    //get a connection from pool, an empty lease on timeout
+    lease get(int timeout = 0) {
+        typename Stats::stamp start = Stats::now();
         //std::scoped_lock lock(mutex);
         std::unique_lock<std::mutex> lock(mutex);
-        if (!idle.empty()) {
-            T* conn = idle.front();
-            idle.pop();
-            in_use.insert(conn);
-            return conn;
+        if (idle_head != NIL && !wait_head) {
+            return make_lease(take_idle(), start);
         }
-        while (idle.empty()) {
+        if (fair) {
+            return wait_turn(lock, timeout, start);
+        }
+        auto deadline = clock::now() + std::chrono::milliseconds(timeout);
+        bool tried = false;
+        while (idle_head == NIL) {
+            if (!tried && can_grow()) {
+                //one attempt per call, a failing backend must not turn get into a busy loop
+                tried = true;
+                uint32_t i = create(lock);
+                if (i != NIL) {
+                    return make_lease(i, start);
+                }
+                continue;
+            }
+            waiting++;
             if (timeout > 0) {
-                if (std::cv_status::timeout == cond.wait_for(lock, std::chrono::milliseconds(timeout))) {
-                    return NULL;
+                std::cv_status st = cond.wait_until(lock, deadline);
+                waiting--;
+                if (std::cv_status::timeout == st) {
+                    if (idle_head == NIL) {
+                        counters.on_timeout();
+                        return lease();
+                    }
+                    break;
                 }
             } else {
                 cond.wait(lock);
+                waiting--;
             }
+            //woken with nothing idle, a retired connection may have left room
+            tried = false;
+        }
+        return make_lease(take_idle(), start);
+    }
+    
+private:
+    //a get() or async_acquire() queued for a connection, lives on the caller's
+    //stack or in the coroutine frame. release_idle fills in index before waking it
+    struct waiter {
+        uint32_t index;
+        waiter *prev;
+        waiter *next;
+        std::condition_variable *cv;    //NULL for a suspended coroutine
+        bool retry;                     //room was left but the factory failed, try it again
+        typename Stats::stamp start;
+#if TML_HAS_COROUTINES
+        coro::scheduler *s;
+        std::coroutine_handle<> handle;
+#endif
+    };
+    
+public:
+#if TML_HAS_COROUTINES
+    //lease conn = co_await pool.async_acquire(sched);
+    //suspends the coroutine until a connection is free and resumes it on sched,
+    //so thousands of waiting requests don't each pin an OS thread
+    class acquire_awaiter {
+    public:
+        acquire_awaiter(connection_pool *pool, coro::scheduler *s) : pool(pool) {
+            w.index = NIL;
+            w.cv = NULL;
+            w.retry = false;
+            w.s = s;
+            w.start = Stats::now();
+        }
+    
+        bool await_ready() {
+            return false;
+        }
+    
+        bool await_suspend(std::coroutine_handle<> h) {
+            std::unique_lock<std::mutex> lock(pool->mutex);
+            if (pool->idle_head != NIL && !pool->wait_head) {
+                w.index = pool->take_idle();
+                return false;
+            }
+            if (pool->can_grow() && (w.index = pool->create(lock)) != NIL) {
+                return false;
+            }
+            w.handle = h;
+            pool->enqueue(&w);
+            return true;
+        }
+    
+        lease await_resume() {
+            std::unique_lock<std::mutex> lock(pool->mutex);
+            return pool->make_lease(w.index, w.start);
+        }
+    
+    private:
+        connection_pool *pool;
+        waiter w;
+    };
+    
+    acquire_awaiter async_acquire(coro::scheduler &sched) {
+        return acquire_awaiter(this, &sched);
+    }
+#endif
+    
+private:
+    static const uint32_t NIL = 0xffffffff;
+    
+    enum slot_state {
+        SLOT_FREE,      //on the free list, conn is meaningless
+        SLOT_IDLE,      //linked into the idle list
+        SLOT_IN_USE,    //leased out
+        SLOT_BAD,       //waiting in the reconnect heap
+        SLOT_BUSY,      //being created or probed, the lock is not held
+    };
+    
+    //one per connection, reused after eviction, so leases cost no allocation.
+    //prev/next link the idle list, oldest at idle_head, or the free list.
+    //the Stats::stamp base records when the current lease was handed out
+    struct slot : Stats::stamp {
+        T *conn;
+        slot_state state;
+        bool owned;
+        int attempts;
+        clock::time_point since;
+        uint32_t prev;
+        uint32_t next;
+    };
+    
+    struct bad_conn {
+        uint32_t index;
+        clock::time_point retry_at;
+    
+        //std::priority_queue is a max-heap, earliest retry must come out first
+        bool operator<(const bad_conn &o) const {
+            return retry_at > o.retry_at;
+        }
+    };
+    
+    //caller holds the lock
+    lease make_lease(uint32_t i, const typename Stats::stamp &wait_start) {
+        counters.on_acquire(wait_start);
+        in_use_count++;
+        static_cast<typename Stats::stamp &>(slots[i]) = Stats::now();
+        return lease(this, i, slots[i].conn);
+    }
+    
+    //caller holds the lock
+    uint32_t new_slot(T *conn, bool owned) {
+        uint32_t i = free_head;
+        if (i != NIL) {
+            free_head = slots[i].next;
+        } else {
+            i = (uint32_t)slots.size();
+            slots.push_back(slot());
         }
-        T* conn = idle.front();
-        idle.pop();
-        in_use.insert(conn);
-        return conn;
+        slot &s = slots[i];
+        s.conn = conn;
+        s.state = SLOT_BUSY;
+        s.owned = owned;
+        s.attempts = 0;
+        s.prev = s.next = NIL;
+        total++;
+        return i;
+    }
+    
+    //caller holds the lock
+    void free_slot(uint32_t i) {
+        slots[i].state = SLOT_FREE;
+        slots[i].conn = NULL;
+        slots[i].next = free_head;
+        free_head = i;
+        total--;
+    }
+    
+    //caller holds the lock. append as the most recently used idle connection
+    void idle_push(uint32_t i) {
+        slot &s = slots[i];
+        s.state = SLOT_IDLE;
+        s.since = clock::now();
+        idle_count++;
+        s.prev = idle_tail;
+        s.next = NIL;
+        if (idle_tail != NIL) {
+            slots[idle_tail].next = i;
+        } else {
+            idle_head = i;
+        }
+        idle_tail = i;
+    }
+    
+    //caller holds the lock
+    void idle_unlink(uint32_t i) {
+        slot &s = slots[i];
+        if (s.prev != NIL) {
+            slots[s.prev].next = s.next;
+        } else {
+            idle_head = s.next;
+        }
+        if (s.next != NIL) {
+            slots[s.next].prev = s.prev;
+        } else {
+            idle_tail = s.prev;
+        }
+        s.prev = s.next = NIL;
+        s.state = SLOT_BUSY;
+        idle_count--;
+    }
+    
+    //caller holds the lock and idle is not empty.
+    //most recently used first, so surplus connections age at the front and get evicted
+    uint32_t take_idle() {
+        uint32_t i = idle_tail;
+        idle_unlink(i);
+        slots[i].state = SLOT_IN_USE;
+        return i;
     }
     
     //put a connection back to pool
-    bool put_back(T *conn) {
+    void put_back(uint32_t i) {
         //std::scoped_lock lock(mutex);
         std::unique_lock<std::mutex> lock(mutex);
-        idle.push(conn);
-        in_use.erase(conn);
-        cond.notify_one();
-        return true;
+        lease_done(i);
+        release_idle(i);
     }
     
     //mark a connection as invalid
-    bool mark_invalid(T* conn) {
+    void mark_invalid(uint32_t i) {
         //std::scoped_lock lock(mutex);
         std::unique_lock<std::mutex> lock(mutex);
-        in_use.erase(conn);
-        bad.push(conn);
-        return true;
+        lease_done(i);
+        invalidate(lock, i);
     }
     
-private:
-    //auto reconnect in a seperate thread
-    static void reconnect(connection_pool<T> *pool) {
-        while (true) {
-            if (pool->bad.empty()) {
-                std::this_thread::sleep_for(std::chrono::milliseconds(100));
+    //caller holds the lock. without the reconnect thread nothing would ever repair
+    //the connection, so it leaves the pool instead of holding a slot forever
+    void invalidate(std::unique_lock<std::mutex> &lock, uint32_t i) {
+        if (auto_reconnect) {
+            push_bad(i, 0);
+        } else {
+            retire(lock, i);
+        }
+    }
+    
+    //caller holds the lock. factory-made connections are closed outside the lock,
+    //hand-added ones are just dropped and stay the caller's
+    void retire(std::unique_lock<std::mutex> &lock, uint32_t i) {
+        T *conn = slots[i].conn;
+        bool owned = slots[i].owned;
+        free_slot(i);
+        if (owned) {
+            std::function<void(T *)> close = destroy;
+            lock.unlock();
+            close(conn);
+            lock.lock();
+        }
+        refill(lock);
+    }
+    
+    //caller holds the lock. a slot was freed while callers may be waiting for one,
+    //open its replacement now rather than leave them asleep until their timeout.
+    //when the factory fails, blocked get() calls and the head of the fair queue try
+    //it themselves once more, and the reconnect thread tries again after backoff_min
+    //for as long as anyone waits. a queued coroutine can't run the factory, so it
+    //is served by those retries through release_idle
+    void refill(std::unique_lock<std::mutex> &lock) {
+        if (!waiting || !can_grow()) {
+            return;
+        }
+        uint32_t i = create(lock);
+        if (i != NIL) {
+            release_idle(i);
+            return;
+        }
+        cond.notify_all();
+        if (wait_head && wait_head->cv) {
+            wait_head->retry = true;
+            wait_head->cv->notify_one();
+        }
+        next_refill = clock::now() + std::chrono::milliseconds(backoff_min);
+        ensure_maintenance();
+        bad_cond.notify_one();
+    }
+    
+    //caller holds the lock
+    void lease_done(uint32_t i) {
+        counters.on_release(slots[i]);
+        in_use_count--;
+    }
+    
+    //caller holds the lock. fair mode get(): open a connection if allowed,
+    //otherwise join the back of the queue and sleep on a private condition variable
+    //until release_idle hands a connection over or the deadline passes
+    lease wait_turn(std::unique_lock<std::mutex> &lock, int timeout, const typename Stats::stamp &start) {
+        if (can_grow()) {
+            uint32_t i = create(lock);
+            if (i != NIL) {
+                return make_lease(i, start);
+            }
+            if (idle_head != NIL && !wait_head) {
+                return make_lease(take_idle(), start);
+            }
+        }
+        std::condition_variable cv;
+        waiter w;
+        w.index = NIL;
+        w.cv = &cv;
+        w.retry = false;
+        w.start = start;
+        enqueue(&w);
+        auto deadline = clock::now() + std::chrono::milliseconds(timeout);
+        while (w.index == NIL) {
+            if (w.retry && can_grow()) {
+                //stay queued while the factory runs, release_idle may still hand one over
+                w.retry = false;
+                uint32_t i = create(lock);
+                if (i != NIL) {
+                    if (w.index == NIL) {
+                        unlink_waiter(&w);
+                        return make_lease(i, start);
+                    }
+                    release_idle(i);
+                }
                 continue;
             }
-            T* conn = NULL;
-            {
-                //std::scoped_lock lock(pool->mutex);
-                std::unique_lock<std::mutex> lock(pool->mutex);
-                if (!pool->bad.empty()) {
-                    conn = pool->bad.front();
-                    pool->bad.pop();
+            if (timeout > 0) {
+                if (std::cv_status::timeout == cv.wait_until(lock, deadline) && w.index == NIL) {
+                    unlink_waiter(&w);
+                    counters.on_timeout();
+                    return lease();
                 }
+            } else {
+                cv.wait(lock);
+            }
+        }
+        return make_lease(w.index, start);
+    }
+    
+    //caller holds the lock
+    void enqueue(waiter *w) {
+        w->prev = wait_tail;
+        w->next = NULL;
+        if (wait_tail) {
+            wait_tail->next = w;
+        } else {
+            wait_head = w;
+        }
+        wait_tail = w;
+        waiting++;
+    }
+    
+    //caller holds the lock
+    void unlink_waiter(waiter *w) {
+        if (w->prev) {
+            w->prev->next = w->next;
+        } else {
+            wait_head = w->next;
+        }
+        if (w->next) {
+            w->next->prev = w->prev;
+        } else {
+            wait_tail = w->prev;
+        }
+        waiting--;
+    }
+    
+    //caller holds the lock
+    bool can_grow() {
+        return factory && (!max_size || total < max_size);
+    }
+    
+    //caller holds the lock, which is dropped while the factory runs.
+    //returns the slot of the new connection already marked in use, or NIL
+    uint32_t create(std::unique_lock<std::mutex> &lock) {
+        std::function<T *()> make = factory;
+        uint32_t i = new_slot(NULL, true);
+        creating++;
+        lock.unlock();
+        T *conn = make();
+        lock.lock();
+        creating--;
+        if (!conn) {
+            free_slot(i);
+            return NIL;
+        }
+        slots[i].conn = conn;
+        slots[i].state = SLOT_IN_USE;
+        return i;
+    }
+    
+    //caller holds the lock. probes and eviction need the background thread
+    //even when auto reconnect is off
+    void ensure_maintenance() {
+        if (!reconnector.joinable()) {
+            reconnector = std::thread(&connection_pool::reconnect, this);
+        }
+    }
+    
+    //caller holds the lock. when the oldest idle connection becomes evictable
+    clock::time_point next_eviction() {
+        if (!idle_ttl || idle_head == NIL || total <= min_size) {
+            return clock::time_point::max();
+        }
+        return slots[idle_head].since + std::chrono::milliseconds(idle_ttl);
+    }
+    
+    //caller holds the lock. only factory-made connections are closed, outside the lock
+    void evict_idle(std::unique_lock<std::mutex> &lock, clock::time_point now) {
+        clock::time_point stale = now - std::chrono::milliseconds(idle_ttl);
+        std::vector<T *> closing;
+        while (idle_head != NIL && slots[idle_head].since <= stale && total > min_size) {
+            uint32_t i = idle_head;
+            idle_unlink(i);
+            if (slots[i].owned) {
+                closing.push_back(slots[i].conn);
+                free_slot(i);
+            } else {
+                //hand-added connections are never evicted, requeue them as fresh
+                idle_push(i);
+            }
+        }
+        if (closing.empty()) {
+            return;
+        }
+        std::function<void(T *)> close = destroy;
+        lock.unlock();
+        for (size_t i = 0; i < closing.size(); i++) {
+            close(closing[i]);
+        }
+        lock.lock();
+    }
+    
+    //caller holds the lock. schedules a reconnect attempt, the first one right away
+    void push_bad(uint32_t i, int attempts) {
+        slots[i].state = SLOT_BAD;
+        slots[i].attempts = attempts;
+        bad_conn b = { i, clock::now() };
+        if (attempts > 0) {
+            int shift = attempts - 1 < 20 ? attempts - 1 : 20;
+            long delay = (long)backoff_min << shift;
+            if (delay > backoff_max) {
+                delay = backoff_max;
+            }
+            std::uniform_int_distribution<long> jitter(delay / 2, delay + delay / 2);
+            b.retry_at += std::chrono::milliseconds(jitter(rng));
+        }
+        bad.push(b);
+        bad_cond.notify_one();
+    }
+    
+    //caller holds the lock. the oldest queued waiter gets the connection directly and
+    //is the only one woken, otherwise it goes back to idle for unfair blocked threads
+    void release_idle(uint32_t i) {
+        waiter *w = wait_head;
+        if (w) {
+            unlink_waiter(w);
+            slots[i].state = SLOT_IN_USE;
+            w->index = i;
+#if TML_HAS_COROUTINES
+            if (!w->cv) {
+                w->s->schedule(w->handle);
+                return;
             }
-            if (conn) {
-                if (conn->reconnect()) {
-                    //std::scoped_lock lock(pool->mutex);
-                    std::unique_lock<std::mutex> lock(pool->mutex);
-                    pool->idle.push(conn);
-                    pool->cond.notify_one();
+#endif
+            w->cv->notify_one();
+            return;
+        }
+        idle_push(i);
+        cond.notify_one();
+    }
+    
+    //auto reconnect in a seperate thread.
+    //sleeps until a connection is marked invalid, its backoff expires, a probe
+    //is due, an idle connection outlives its ttl or a failed refill is retried
+    void reconnect() {
+        std::unique_lock<std::mutex> lock(mutex);
+        while (!stopping) {
+            clock::time_point now = clock::now();
+            if (auto_reconnect && !bad.empty() && bad.top().retry_at <= now) {
+                uint32_t i = bad.top().index;
+                bad.pop();
+                T *conn = slots[i].conn;
+                lock.unlock();
+                bool ok = conn->reconnect();
+                counters.on_reconnect(ok);
+                lock.lock();
+                if (ok) {
+                    release_idle(i);
+                } else if (slots[i].owned && reconnect_limit && slots[i].attempts + 1 >= reconnect_limit) {
+                    //give up on it, the factory may still open a working one
+                    retire(lock, i);
                 } else {
-                    //std::scoped_lock lock(pool->mutex);
-                    std::unique_lock<std::mutex> lock(pool->mutex);
-                    pool->bad.push(conn);
+                    push_bad(i, slots[i].attempts + 1);
                 }
+                continue;
+            }
+            if (next_probe <= now) {
+                probe_idle(lock, now);
+                continue;
+            }
+            if (next_eviction() <= now) {
+                evict_idle(lock, now);
+                continue;
+            }
+            if (next_refill <= now) {
+                next_refill = clock::time_point::max();
+                refill(lock);
+                continue;
+            }
+            clock::time_point wake = next_probe < next_refill ? next_probe : next_refill;
+            if (auto_reconnect && !bad.empty() && bad.top().retry_at < wake) {
+                wake = bad.top().retry_at;
+            }
+            if (next_eviction() < wake) {
+                wake = next_eviction();
+            }
+            if (wake == clock::time_point::max()) {
+                bad_cond.wait(lock);
+            } else {
+                bad_cond.wait_until(lock, wake);
+            }
+        }
+    }
+    
+    //caller holds the lock. the idle list is oldest first, so connections idle
+    //for a whole interval sit at the front. each is probed outside the lock
+    void probe_idle(std::unique_lock<std::mutex> &lock, clock::time_point now) {
+        std::function<bool(T *)> probe = health_probe;
+        clock::time_point stale = now - std::chrono::milliseconds(probe_interval);
+        std::vector<uint32_t> checking;
+        while (idle_head != NIL && slots[idle_head].since <= stale) {
+            checking.push_back(idle_head);
+            idle_unlink(idle_head);
+        }
+        next_probe = now + std::chrono::milliseconds(probe_interval);
+        for (size_t k = 0; k < checking.size(); k++) {
+            T *conn = slots[checking[k]].conn;
+            lock.unlock();
+            bool ok = probe(conn);
+            lock.lock();
+            if (ok) {
+                release_idle(checking[k]);
+            } else {
+                invalidate(lock, checking[k]);
             }
-            std::this_thread::sleep_for(std::chrono::milliseconds(100));
         }
     }
     
-    std::queue<T *> idle;
-    std::queue<T *> bad;
-    std::set<T *> in_use;
+    std::vector<slot> slots;
+    uint32_t idle_head;
+    uint32_t idle_tail;
+    uint32_t free_head;
+    std::priority_queue<bad_conn> bad;
+    waiter *wait_head;
+    waiter *wait_tail;
+    bool fair;
+    const bool auto_reconnect;
+    bool stopping;
+    int backoff_min;
+    int backoff_max;
+    int reconnect_limit;
+    std::function<bool(T *)> health_probe;
+    int probe_interval;
+    clock::time_point next_probe;
+    clock::time_point next_refill;
+    std::minstd_rand rng;
+    
+    std::function<T *()> factory;
+    std::function<void(T *)> destroy;
+    size_t total;
+    size_t creating;
+    size_t min_size;
+    size_t max_size;
+    int idle_ttl;
+    
+    Stats counters;
+    size_t idle_count;
+    size_t in_use_count;
+    size_t waiting;
+    
     std::mutex mutex;
     std::condition_variable cond;
+    std::condition_variable bad_cond;
+    std::thread reconnector;
 };
 }
 
@@ -8,6 +8,7 @@
 #include<iostream>
 
 #include "Curl.h"
+#include "CurlContext.h"
 
 //static size_t WriteCallback(void *content, size_t size, size_t nmemb, void *userp){
 //    size_t realsize = size * nmemb;
@@ -27,25 +28,63 @@
 
 static size_t WriteCallback(void *content, size_t size, size_t nmemb, void *userp){
     size_t n = size * nmemb;
-    ((std::string*)userp) -> append((char*)content, n);
-    return n;
+    // anything but n makes curl fail the transfer with CURLE_WRITE_ERROR
+    return ((const CurlSink*)userp) -> Write((const char*)content, n) ? n : 0;
+}
+
+static size_t ReadCallback(char *buffer, size_t size, size_t nitems, void *userp){
+    return (*(const BodyReader*)userp)(buffer, size * nitems);
+}
+
+bool CurlSink::Write(const char *data, size_t len) const {
+    if(str){
+        str -> append(data, len);
+        return true;
+    }
+    if(buf){
+        if(buf -> size + len > buf -> capacity){
+            buf -> overflow = true;
+            return false;
+        }
+        memcpy(buf -> data + buf -> size, data, len);
+        buf -> size += len;
+        return true;
+    }
+    if(handler)
+        return handler(data, len);
+    return true;
 }
 
 bool Curl::Init(){
     //chunk.memory = malloc(1);
     //chunk.size = 0;
 
+    CurlContext::GlobalInit();
     curl_handle = curl_easy_init();
+    if(curl_handle == NULL)
+        return false;
     curl_easy_setopt(curl_handle, CURLOPT_WRITEFUNCTION, WriteCallback);
-    head = NULL;
+    if(ctx)
+        ctx -> Attach(curl_handle);
+    if(head)
+        curl_easy_setopt(curl_handle, CURLOPT_HTTPHEADER, head);
+    if(acceptEncoding)
+        curl_easy_setopt(curl_handle, CURLOPT_ACCEPT_ENCODING, "");
 
     // time out 
     curl_easy_setopt(curl_handle, CURLOPT_NOSIGNAL, 1L);
-    curl_easy_setopt(curl_handle, CURLOPT_TIMEOUT, 5L);
+    curl_easy_setopt(curl_handle, CURLOPT_TIMEOUT, (long)timeout);
     return true;
 }
 
+bool Curl::reconnect(){
+    curl_easy_cleanup(curl_handle);
+    curl_handle = NULL;
+    return Init();
+}
+
 bool Curl::SetHeaders(std::vector<std::string> &headers) {
+    encodedHeadDirty = true;
     curl_slist *temp = NULL;
     for(auto it : headers){
         temp = curl_slist_append(head, it.c_str());
@@ -59,12 +98,17 @@ bool Curl::SetHeaders(std::vector<std::string> &headers) {
 }
 
 bool Curl::SetTimeout(unsigned int timeout){
+    this -> timeout = timeout;
     curl_easy_setopt(curl_handle, CURLOPT_NOSIGNAL, 1L);
-    curl_easy_setopt(curl_handle, CURLOPT_TIMEOUT, timeout);
+    curl_easy_setopt(curl_handle, CURLOPT_TIMEOUT, (long)timeout);
+    return true;
 }
 
 bool Curl::ResetHeaders(std::vector<std::string> &headers) {
+    encodedHeadDirty = true;
     // NULL in list argument to create new list
+    curl_easy_setopt(curl_handle, CURLOPT_HTTPHEADER, NULL);
+    curl_slist_free_all(head);
     head = NULL;
     curl_slist *temp = NULL;
     for(auto it : headers){
@@ -79,14 +123,73 @@ bool Curl::ResetHeaders(std::vector<std::string> &headers) {
 }
 
 
+bool Curl::SetCompression(ContentEncoding encoding, size_t threshold, int level){
+    compressThreshold = threshold;
+    encodedHeadDirty = true;
+    if(!compressor.Init(encoding, level)){
+        compressor.Init(ENCODING_IDENTITY);
+        return false;
+    }
+    return true;
+}
+
+void Curl::SetAcceptEncoding(bool on){
+    acceptEncoding = on;
+    // "" lets curl list whatever it was built with: gzip, deflate, br, zstd
+    curl_easy_setopt(curl_handle, CURLOPT_ACCEPT_ENCODING, on ? "" : NULL);
+}
+
+curl_slist *Curl::EncodedHeaders(){
+    if(!encodedHeadDirty)
+        return encodedHead;
+    curl_slist_free_all(encodedHead);
+    encodedHead = NULL;
+    for(curl_slist *it = head; it; it = it -> next){
+        curl_slist *temp = curl_slist_append(encodedHead, it -> data);
+        if(temp == NULL)
+            return encodedHead;
+        encodedHead = temp;
+    }
+    std::string encoding = std::string("Content-Encoding: ") + compressor.Name();
+    curl_slist *temp = curl_slist_append(encodedHead, encoding.c_str());
+    if(temp)
+        encodedHead = temp;
+    encodedHeadDirty = false;
+    return encodedHead;
+}
+
 bool Curl::Post(const std::string &url, const std::string &content, void *chunk){
-    curl_easy_setopt(curl_handle, CURLOPT_WRITEDATA, chunk);
+    return Post(url, CurlBody(content), CurlSink((std::string*)chunk));
+}
+
+bool Curl::Post(const std::string &url, const CurlBody &body, const CurlSink &sink){
+    curl_easy_setopt(curl_handle, CURLOPT_WRITEDATA, &sink);
     curl_easy_setopt(curl_handle, CURLOPT_URL, url.c_str());
-    curl_easy_setopt(curl_handle, CURLOPT_POSTFIELDS, content.c_str());
-    // for large content
-    curl_easy_setopt(curl_handle, CURLOPT_POSTFIELDSIZE, content.size());
+    bool compressed = false;
+    if(body.reader){
+        // POSTFIELDS NULL makes curl pull the body through the read callback
+        curl_easy_setopt(curl_handle, CURLOPT_POST, 1L);
+        curl_easy_setopt(curl_handle, CURLOPT_POSTFIELDS, NULL);
+        curl_easy_setopt(curl_handle, CURLOPT_READFUNCTION, ReadCallback);
+        curl_easy_setopt(curl_handle, CURLOPT_READDATA, &body.reader);
+        // for large content, -1 sends chunked
+        curl_easy_setopt(curl_handle, CURLOPT_POSTFIELDSIZE_LARGE, (curl_off_t)body.size);
+    } else {
+        const char *data = body.data;
+        size_t size = (size_t)body.size;
+        if(compressor.Encoding() != ENCODING_IDENTITY && size >= compressThreshold)
+            compressed = compressor.Compress(body.data, size, &data, &size);
+        // curl sends straight from the borrowed memory or the compressor's buffer, no copy
+        curl_easy_setopt(curl_handle, CURLOPT_POSTFIELDS, data);
+        // for large content
+        curl_easy_setopt(curl_handle, CURLOPT_POSTFIELDSIZE_LARGE, (curl_off_t)size);
+    }
+    // every time, the last Post may have left the Content-Encoding list on the handle
+    curl_easy_setopt(curl_handle, CURLOPT_HTTPHEADER, compressed ? EncodedHeaders() : head);
     
     res = curl_easy_perform(curl_handle);
+    if(timings)
+        timings -> Record(url, curl_handle, res);
 
     if(res != CURLE_OK){
         std::cerr << "curl_easy_perform() faild: " << curl_easy_strerror(res) << std::endl;
@@ -96,9 +199,16 @@ bool Curl::Post(const std::string &url, const std::string &content, void *chunk)
     return true;
 }
 
+long Curl::ResponseCode() const {
+    long code = 0;
+    curl_easy_getinfo(curl_handle, CURLINFO_RESPONSE_CODE, &code);
+    return code;
+}
+
 Curl::~Curl(){
     //free(chunk.memory);
-    curl_slist_free_all(head);
     curl_easy_cleanup(curl_handle);
-    curl_global_cleanup();
+    curl_slist_free_all(head);
+    curl_slist_free_all(encodedHead);
+    // no curl_global_cleanup here, other handles in the process may still be alive
 }
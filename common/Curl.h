@@ -12,28 +12,118 @@
 #include <vector>
 #include <cstdlib>
 #include <cstring>
+#include <functional>
 
 #include <curl/curl.h>
 
+#include "CurlCompressor.h"
+#include "CurlTimings.h"
+
+class CurlContext;
+
 struct MemoryStruct {
     char *memory;
     size_t size;
 };
 
+//called for every piece of the response as it arrives, data points into curl's own buffer.
+//return false to abort the transfer
+typedef std::function<bool(const char *data, size_t len)> ChunkHandler;
+
+//fills buf with up to len bytes of the request body, returns how many, 0 at the end.
+//return CURL_READFUNC_ABORT to abort the transfer
+typedef std::function<size_t(char *buf, size_t len)> BodyReader;
+
+//caller owned memory for a response, e.g. from an arena. a response that
+//doesn't fit fails the transfer with CURLE_WRITE_ERROR and sets overflow
+struct CurlBuffer {
+    char *data;
+    size_t capacity;
+    size_t size;
+    bool overflow;
+
+    CurlBuffer(char *data, size_t capacity) : data(data), capacity(capacity), size(0), overflow(false) {}
+};
+
+//where a response body goes: appended to a string, copied into a CurlBuffer
+//or streamed to a ChunkHandler without being stored
+class CurlSink {
+    public :
+        CurlSink() : str(NULL), buf(NULL) {}
+        CurlSink(std::string *str) : str(str), buf(NULL) {}
+        CurlSink(CurlBuffer *buf) : str(NULL), buf(buf) {}
+        CurlSink(ChunkHandler handler) : str(NULL), buf(NULL), handler(std::move(handler)) {}
+
+        bool Write(const char *data, size_t len) const;
+
+    private:
+        std::string *str;
+        CurlBuffer *buf;
+        ChunkHandler handler;
+};
+
+//where a request body comes from: memory borrowed for the duration of the call,
+//or a BodyReader pulled as curl sends. size -1 means unknown, sent chunked
+class CurlBody {
+    public :
+        CurlBody(const char *data, size_t size) : data(data), size((long long)size) {}
+        CurlBody(const std::string &content) : data(content.data()), size((long long)content.size()) {}
+        CurlBody(BodyReader reader, long long size = -1) : data(NULL), size(size), reader(std::move(reader)) {}
+
+    private:
+        friend class Curl;
+        const char *data;
+        long long size;
+        BodyReader reader;
+};
+
 class Curl {
     public :
-        Curl(){}
+        //with a context the handle shares its DNS and TLS session caches
+        explicit Curl(CurlContext *ctx = NULL) : ctx(ctx), curl_handle(NULL), head(NULL), timeout(5),
+            compressThreshold(0), encodedHead(NULL), encodedHeadDirty(true), acceptEncoding(false), timings(NULL) {}
 
         bool Init();
         bool SetHeaders(std::vector<std::string> &headers);
         bool SetTimeout(unsigned int timeout);
         bool ResetHeaders(std::vector<std::string> &headers);
+        //compress request bodies of at least threshold bytes and label them with
+        //Content-Encoding. ENCODING_IDENTITY turns it off again
+        bool SetCompression(ContentEncoding encoding, size_t threshold = 1024, int level = -1);
+        //advertise every encoding libcurl can decode and decode responses transparently
+        void SetAcceptEncoding(bool on);
+        //every Post is recorded into timings, NULL turns it off. timings must outlive the handle
+        void SetTimings(CurlTimings *timings) { this -> timings = timings; }
+        //HTTP status of the last Post, 0 when no response arrived
+        long ResponseCode() const;
+        //phase timings and sizes of the last Post
+        bool GetTiming(CurlTiming &timing) const { return timing.Read(curl_handle); }
         bool Post(const std::string &url, const std::string &content, void *chunk);
+        //body and sink are only used during the call, nothing is copied into the handle
+        bool Post(const std::string &url, const CurlBody &body, const CurlSink &sink);
+        //drop the easy handle and open a fresh one with the same headers and timeout,
+        //named for common::connection_pool which calls it on handles marked invalid
+        bool reconnect();
         ~Curl();
 
     private:
+        Curl(const Curl &) = delete;
+        Curl &operator=(const Curl &) = delete;
+
+        CurlContext *ctx;
         CURL *curl_handle;
         CURLcode res;
         curl_slist *head;
+        unsigned int timeout;
+
+        curl_slist *EncodedHeaders();
+
+        CurlCompressor compressor;
+        size_t compressThreshold;
+        //head plus Content-Encoding, rebuilt when the headers change
+        curl_slist *encodedHead;
+        bool encodedHeadDirty;
+        bool acceptEncoding;
+        CurlTimings *timings;
         //struct MemoryStruct chunk;
 };
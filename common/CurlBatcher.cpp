@@ -0,0 +1,174 @@
+/*************************************************************************
+    > File Name: CurlBatcher.cpp
+    > Author: Jun Zhang
+    > Mail: ewalker.zj@gmail.com
+    > Created Time: Sat 17 Oct 2026 02:24:13 PM CST
+ ************************************************************************/
+
+#include <memory>
+
+#include "CurlBatcher.h"
+
+CurlBatcher::CurlBatcher(AsyncCurl &client, BatchOptions options)
+    : client(client), options(std::move(options)), lines(false), stopping(false){
+    if(!this -> options.join){
+        this -> options.join = JoinLines;
+        lines = true;
+    }
+    if(!this -> options.split)
+        this -> options.split = SplitLines;
+    if(this -> options.maxCount == 0)
+        this -> options.maxCount = 1;
+    linger = std::thread(&CurlBatcher::Linger, this);
+}
+
+CurlBatcher::~CurlBatcher(){
+    {
+        std::unique_lock<std::mutex> lock(mutex);
+        stopping = true;
+        cond.notify_all();
+    }
+    linger.join();
+    Flush();
+}
+
+void CurlBatcher::Post(const std::string &url, std::string payload, AsyncCallback cb){
+    // it would come back as two parts and shift every later caller's answer
+    if(lines && payload.find('\n') != std::string::npos){
+        AsyncResponse resp;
+        resp.code = CURLE_BAD_FUNCTION_ARGUMENT;
+        resp.error = "payload contains a newline";
+        if(cb)
+            cb(resp);
+        return;
+    }
+    Batch full;
+    {
+        std::unique_lock<std::mutex> lock(mutex);
+        Batch &b = batches[url];
+        if(b.payloads.empty()){
+            b.deadline = clock::now() + std::chrono::milliseconds(options.lingerMs);
+            cond.notify_one();
+        }
+        b.bytes += payload.size();
+        b.payloads.push_back(std::move(payload));
+        b.callbacks.push_back(std::move(cb));
+        if(b.payloads.size() < options.maxCount && b.bytes < options.maxBytes)
+            return;
+        std::swap(full, b);
+    }
+    Send(url, full);
+}
+
+std::future<AsyncResponse> CurlBatcher::Post(const std::string &url, std::string payload){
+    std::shared_ptr<std::promise<AsyncResponse> > p = std::make_shared<std::promise<AsyncResponse> >();
+    std::future<AsyncResponse> f = p -> get_future();
+    Post(url, std::move(payload), [p](AsyncResponse &resp){ p -> set_value(std::move(resp)); });
+    return f;
+}
+
+void CurlBatcher::Flush(){
+    std::unordered_map<std::string, Batch> all;
+    {
+        std::unique_lock<std::mutex> lock(mutex);
+        all.swap(batches);
+    }
+    for(auto &it : all){
+        if(!it.second.payloads.empty())
+            Send(it.first, it.second);
+    }
+}
+
+void CurlBatcher::Send(const std::string &url, Batch &batch){
+    AsyncRequest req;
+    req.url = url;
+    req.headers = options.headers;
+    req.timeoutMs = options.timeoutMs;
+    req.body = options.join(batch.payloads);
+
+    // the completion owns the callbacks, it may run after the batcher is gone
+    std::shared_ptr<std::vector<AsyncCallback> > callbacks = std::make_shared<std::vector<AsyncCallback> >();
+    callbacks -> swap(batch.callbacks);
+    std::function<bool(const std::string &, size_t, std::vector<std::string> &)> split = options.split;
+    AsyncCallback done = [callbacks, split](AsyncResponse &resp){
+        std::vector<std::string> parts;
+        bool ok = resp.Ok() && split(resp.body, callbacks -> size(), parts) && parts.size() == callbacks -> size();
+        for(size_t i = 0; i < callbacks -> size(); i++){
+            AsyncResponse one;
+            one.code = resp.code;
+            one.status = resp.status;
+            one.error = resp.error;
+            one.httpVersion = resp.httpVersion;
+            if(ok){
+                one.body = std::move(parts[i]);
+            } else if(resp.Ok()){
+                // nobody can tell which part is theirs, don't hand out a wrong one
+                one.code = CURLE_RECV_ERROR;
+                one.error = "response doesn't split into one part per post";
+            }
+            if((*callbacks)[i])
+                (*callbacks)[i](one);
+        }
+    };
+    if(client.Submit(std::move(req), done) == 0){
+        AsyncResponse resp;
+        resp.code = CURLE_FAILED_INIT;
+        resp.error = "client not running";
+        done(resp);
+    }
+}
+
+void CurlBatcher::Linger(){
+    std::unique_lock<std::mutex> lock(mutex);
+    while(!stopping){
+        clock::time_point now = clock::now();
+        clock::time_point wake = clock::time_point::max();
+        std::vector<std::pair<std::string, Batch> > due;
+        for(auto &it : batches){
+            if(it.second.payloads.empty())
+                continue;
+            if(it.second.deadline <= now){
+                due.push_back(std::make_pair(it.first, Batch()));
+                std::swap(due.back().second, it.second);
+            } else if(it.second.deadline < wake){
+                wake = it.second.deadline;
+            }
+        }
+        if(!due.empty()){
+            lock.unlock();
+            for(auto &it : due)
+                Send(it.first, it.second);
+            lock.lock();
+            continue;
+        }
+        if(wake == clock::time_point::max())
+            cond.wait(lock);
+        else
+            cond.wait_until(lock, wake);
+    }
+}
+
+std::string CurlBatcher::JoinLines(const std::vector<std::string> &payloads){
+    size_t n = 0;
+    for(auto &it : payloads)
+        n += it.size() + 1;
+    std::string body;
+    body.reserve(n);
+    for(auto &it : payloads){
+        body.append(it);
+        body.push_back('\n');
+    }
+    return body;
+}
+
+bool CurlBatcher::SplitLines(const std::string &body, size_t count, std::vector<std::string> &parts){
+    size_t start = 0;
+    while(start < body.size() && parts.size() < count){
+        size_t end = body.find('\n', start);
+        if(end == std::string::npos)
+            end = body.size();
+        parts.push_back(body.substr(start, end - start));
+        start = end + 1;
+    }
+    return parts.size() == count;
+}
@@ -0,0 +1,89 @@
+/*************************************************************************
+    > File Name: CurlBatcher.h
+    > Author: Jun Zhang
+    > Mail: ewalker.zj@gmail.com
+    > Created Time: Sat 17 Oct 2026 02:20:47 PM CST
+ ************************************************************************/
+
+#pragma once
+
+#include <string>
+#include <vector>
+#include <mutex>
+#include <thread>
+#include <future>
+#include <chrono>
+#include <functional>
+#include <unordered_map>
+#include <condition_variable>
+
+#include "AsyncCurl.h"
+
+struct BatchOptions {
+    //a batch is sent once it holds maxCount posts or maxBytes of payload,
+    //or lingerMs after its first post, whichever comes first
+    size_t maxCount;
+    size_t maxBytes;
+    long lingerMs;
+    std::vector<std::string> headers;
+    long timeoutMs;
+
+    //builds the combined body, newline delimited (NDJSON) by default,
+    //in which case a payload containing '\n' is refused with CURLE_BAD_FUNCTION_ARGUMENT
+    std::function<std::string(const std::vector<std::string> &payloads)> join;
+    //cuts the combined response into one part per post, false when it can't,
+    //in which case every caller gets CURLE_RECV_ERROR with the status but no body.
+    //splits on newlines by default
+    std::function<bool(const std::string &body, size_t count, std::vector<std::string> &parts)> split;
+
+    BatchOptions() : maxCount(64), maxBytes(64 * 1024), lingerMs(5), timeoutMs(0) {}
+};
+
+//coalesces many small posts to the same url into one request on an AsyncCurl,
+//trading up to lingerMs of latency for far fewer round trips.
+//every caller still gets its own completion with its own slice of the response.
+class CurlBatcher {
+    public :
+        //client must be started and outlive the batcher
+        explicit CurlBatcher(AsyncCurl &client, BatchOptions options = BatchOptions());
+        //sends whatever is still queued
+        ~CurlBatcher();
+
+        void Post(const std::string &url, std::string payload, AsyncCallback cb);
+        std::future<AsyncResponse> Post(const std::string &url, std::string payload);
+
+        //send every queued batch now
+        void Flush();
+
+    private:
+        typedef std::chrono::steady_clock clock;
+
+        struct Batch {
+            std::vector<std::string> payloads;
+            std::vector<AsyncCallback> callbacks;
+            size_t bytes;
+            clock::time_point deadline;
+
+            Batch() : bytes(0) {}
+        };
+
+        CurlBatcher(const CurlBatcher &) = delete;
+        CurlBatcher &operator=(const CurlBatcher &) = delete;
+
+        void Send(const std::string &url, Batch &batch);
+        void Linger();
+
+        static std::string JoinLines(const std::vector<std::string> &payloads);
+        static bool SplitLines(const std::string &body, size_t count, std::vector<std::string> &parts);
+
+        AsyncCurl &client;
+        BatchOptions options;
+        //join is JoinLines, payloads must not hold a newline
+        bool lines;
+
+        std::mutex mutex;
+        std::condition_variable cond;
+        std::unordered_map<std::string, Batch> batches;
+        bool stopping;
+        std::thread linger;
+};
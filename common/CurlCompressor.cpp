@@ -0,0 +1,111 @@
+/*************************************************************************
+    > File Name: CurlCompressor.cpp
+    > Author: Jun Zhang
+    > Mail: ewalker.zj@gmail.com
+    > Created Time: Sat 17 Oct 2026 03:43:52 PM CST
+ ************************************************************************/
+
+#include <cstring>
+
+#include "CurlCompressor.h"
+
+CurlCompressor::CurlCompressor() : encoding(ENCODING_IDENTITY), zsInit(false){
+    memset(&zs, 0, sizeof(zs));
+#if TML_HAS_ZSTD
+    zstd = NULL;
+    zstdLevel = 0;
+#endif
+}
+
+CurlCompressor::~CurlCompressor(){
+    Release();
+}
+
+void CurlCompressor::Release(){
+    if(zsInit){
+        deflateEnd(&zs);
+        zsInit = false;
+    }
+#if TML_HAS_ZSTD
+    ZSTD_freeCCtx(zstd);
+    zstd = NULL;
+#endif
+    encoding = ENCODING_IDENTITY;
+}
+
+bool CurlCompressor::Init(ContentEncoding encoding, int level){
+    Release();
+    switch(encoding){
+        case ENCODING_IDENTITY:
+            return true;
+        case ENCODING_GZIP:
+        case ENCODING_DEFLATE:
+            // 16 + MAX_WBITS writes the gzip wrapper, MAX_WBITS alone the zlib one http calls deflate
+            if(deflateInit2(&zs, level < 0 ? Z_DEFAULT_COMPRESSION : level, Z_DEFLATED,
+                        encoding == ENCODING_GZIP ? 16 + MAX_WBITS : MAX_WBITS, 8, Z_DEFAULT_STRATEGY) != Z_OK)
+                return false;
+            zsInit = true;
+            break;
+        case ENCODING_ZSTD:
+#if TML_HAS_ZSTD
+            zstd = ZSTD_createCCtx();
+            if(zstd == NULL)
+                return false;
+            zstdLevel = level < 0 ? 3 : level;
+            break;
+#else
+            return false;
+#endif
+    }
+    this -> encoding = encoding;
+    return true;
+}
+
+const char *CurlCompressor::Name() const {
+    switch(encoding){
+        case ENCODING_GZIP:
+            return "gzip";
+        case ENCODING_DEFLATE:
+            return "deflate";
+        case ENCODING_ZSTD:
+            return "zstd";
+        default:
+            return NULL;
+    }
+}
+
+bool CurlCompressor::Compress(const char *data, size_t len, const char **out, size_t *outLen){
+    if(encoding == ENCODING_IDENTITY){
+        *out = data;
+        *outLen = len;
+        return true;
+    }
+#if TML_HAS_ZSTD
+    if(encoding == ENCODING_ZSTD){
+        size_t bound = ZSTD_compressBound(len);
+        if(buffer.size() < bound)
+            buffer.resize(bound);
+        size_t n = ZSTD_compressCCtx(zstd, buffer.data(), buffer.size(), data, len, zstdLevel);
+        if(ZSTD_isError(n))
+            return false;
+        *out = buffer.data();
+        *outLen = n;
+        return true;
+    }
+#endif
+    // the stream keeps its window and tables, reset only rewinds it
+    if(deflateReset(&zs) != Z_OK)
+        return false;
+    size_t bound = deflateBound(&zs, (uLong)len);
+    if(buffer.size() < bound)
+        buffer.resize(bound);
+    zs.next_in = (Bytef*)data;
+    zs.avail_in = (uInt)len;
+    zs.next_out = (Bytef*)buffer.data();
+    zs.avail_out = (uInt)buffer.size();
+    if(deflate(&zs, Z_FINISH) != Z_STREAM_END)
+        return false;
+    *out = buffer.data();
+    *outLen = zs.total_out;
+    return true;
+}
@@ -0,0 +1,61 @@
+/*************************************************************************
+    > File Name: CurlCompressor.h
+    > Author: Jun Zhang
+    > Mail: ewalker.zj@gmail.com
+    > Created Time: Sat 17 Oct 2026 03:41:09 PM CST
+ ************************************************************************/
+
+#pragma once
+
+#include <vector>
+#include <cstddef>
+
+#include <zlib.h>
+
+//zstd is opt-in, it needs libzstd at link time: build with -DTML_WITH_ZSTD and link zstd
+#ifdef TML_WITH_ZSTD
+#define TML_HAS_ZSTD 1
+#include <zstd.h>
+#else
+#define TML_HAS_ZSTD 0
+#endif
+
+enum ContentEncoding {
+    ENCODING_IDENTITY,
+    ENCODING_GZIP,
+    ENCODING_DEFLATE,
+    ENCODING_ZSTD,      //only when built with TML_WITH_ZSTD, Init fails otherwise
+};
+
+//compresses request bodies for one handle. the compression state and the output
+//buffer live as long as the compressor and are reset, not reallocated, per body,
+//so after the first few requests compressing costs no allocations.
+class CurlCompressor {
+    public :
+        CurlCompressor();
+        ~CurlCompressor();
+
+        //level -1 picks the library default
+        bool Init(ContentEncoding encoding, int level = -1);
+        ContentEncoding Encoding() const { return encoding; }
+        //value for the Content-Encoding header, NULL for identity
+        const char *Name() const;
+
+        //compressed bytes stay valid until the next call
+        bool Compress(const char *data, size_t len, const char **out, size_t *outLen);
+
+    private:
+        CurlCompressor(const CurlCompressor &) = delete;
+        CurlCompressor &operator=(const CurlCompressor &) = delete;
+
+        void Release();
+
+        ContentEncoding encoding;
+        z_stream zs;
+        bool zsInit;
+#if TML_HAS_ZSTD
+        ZSTD_CCtx *zstd;
+        int zstdLevel;
+#endif
+        std::vector<char> buffer;
+};
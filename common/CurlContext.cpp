@@ -0,0 +1,62 @@
+/*************************************************************************
+    > File Name: CurlContext.cpp
+    > Author: Jun Zhang
+    > Mail: ewalker.zj@gmail.com
+    > Created Time: Sat 17 Oct 2026 11:04:51 AM CST
+ ************************************************************************/
+
+#include "CurlContext.h"
+
+static std::once_flag globalInit;
+
+void CurlContext::GlobalInit(){
+    std::call_once(globalInit, []{ curl_global_init(CURL_GLOBAL_ALL); });
+}
+
+CurlContext &CurlContext::Global(){
+    static CurlContext ctx;
+    return ctx;
+}
+
+CurlContext::CurlContext(size_t minHandles, size_t maxHandles){
+    GlobalInit();
+    share = curl_share_init();
+    curl_share_setopt(share, CURLSHOPT_LOCKFUNC, Lock);
+    curl_share_setopt(share, CURLSHOPT_UNLOCKFUNC, Unlock);
+    curl_share_setopt(share, CURLSHOPT_USERDATA, this);
+    curl_share_setopt(share, CURLSHOPT_SHARE, CURL_LOCK_DATA_DNS);
+    curl_share_setopt(share, CURLSHOPT_SHARE, CURL_LOCK_DATA_SSL_SESSION);
+    // not CURL_LOCK_DATA_CONNECT: libcurl doesn't support a connection cache used by
+    // concurrent threads, and its lock would serialize them. each pooled handle keeps
+    // its own connection alive between leases, AsyncCurl reuses through its multi handle
+
+    handles.reset(new CurlPool());
+    handles -> set_factory([this]() -> Curl * {
+        Curl *curl = new Curl(this);
+        if(!curl -> Init()){
+            delete curl;
+            return NULL;
+        }
+        return curl;
+    });
+    handles -> set_limits(minHandles, maxHandles);
+    handles -> prewarm();
+}
+
+CurlContext::~CurlContext(){
+    // handles hold the share, close them first
+    handles.reset();
+    curl_share_cleanup(share);
+}
+
+void CurlContext::Attach(CURL *easy){
+    curl_easy_setopt(easy, CURLOPT_SHARE, share);
+}
+
+void CurlContext::Lock(CURL *easy, curl_lock_data data, curl_lock_access access, void *userp){
+    ((CurlContext*)userp) -> locks[data].lock();
+}
+
+void CurlContext::Unlock(CURL *easy, curl_lock_data data, void *userp){
+    ((CurlContext*)userp) -> locks[data].unlock();
+}
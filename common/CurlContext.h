@@ -0,0 +1,53 @@
+/*************************************************************************
+    > File Name: CurlContext.h
+    > Author: Jun Zhang
+    > Mail: ewalker.zj@gmail.com
+    > Created Time: Sat 17 Oct 2026 11:02:18 AM CST
+ ************************************************************************/
+
+#pragma once
+
+#include <mutex>
+#include <memory>
+
+#include <curl/curl.h>
+
+#include "Curl.h"
+#include "ConnectionPool.h"
+
+typedef common::connection_pool<Curl> CurlPool;
+
+//process level state shared by every Curl and AsyncCurl attached to it:
+//one curl_share for the DNS cache and TLS sessions, so repeated requests to the
+//same host skip lookups and full handshakes, plus a pool of ready Curl handles
+//that are opened on demand and keep their connections open between leases.
+//
+//    auto curl = CurlContext::Global().Handles().get();
+//    curl -> Post(url, body, &out);
+class CurlContext {
+    public :
+        //handles are created lazily up to maxHandles (0 = no limit)
+        //and at least minHandles are kept once opened
+        explicit CurlContext(size_t minHandles = 0, size_t maxHandles = 0);
+        ~CurlContext();
+
+        static CurlContext &Global();
+        //curl_global_init exactly once per process. there is no matching cleanup,
+        //it would pull the rug from under handles still alive at exit
+        static void GlobalInit();
+
+        //make easy use the shared caches, before its first transfer
+        void Attach(CURL *easy);
+        CurlPool &Handles() { return *handles; }
+
+    private:
+        CurlContext(const CurlContext &) = delete;
+        CurlContext &operator=(const CurlContext &) = delete;
+
+        static void Lock(CURL *easy, curl_lock_data data, curl_lock_access access, void *userp);
+        static void Unlock(CURL *easy, curl_lock_data data, void *userp);
+
+        CURLSH *share;
+        std::mutex locks[CURL_LOCK_DATA_LAST];
+        std::unique_ptr<CurlPool> handles;
+};
@@ -0,0 +1,244 @@
+/*************************************************************************
+    > File Name: CurlRetryClient.cpp
+    > Author: Jun Zhang
+    > Mail: ewalker.zj@gmail.com
+    > Created Time: Sat 17 Oct 2026 05:11:48 PM CST
+ ************************************************************************/
+
+#include <vector>
+#include <chrono>
+
+#include "CurlRetryClient.h"
+
+typedef std::chrono::steady_clock clock_type;
+
+static uint64_t NowUs(){
+    return (uint64_t)std::chrono::duration_cast<std::chrono::microseconds>(clock_type::now().time_since_epoch()).count();
+}
+
+static bool DefaultRetryable(const AsyncResponse &resp){
+    switch(resp.code){
+        case CURLE_OK:
+            return resp.status == 429 || resp.status == 502 || resp.status == 503 || resp.status == 504;
+        case CURLE_COULDNT_RESOLVE_HOST:
+        case CURLE_COULDNT_CONNECT:
+        case CURLE_OPERATION_TIMEDOUT:
+        case CURLE_SEND_ERROR:
+        case CURLE_RECV_ERROR:
+        case CURLE_GOT_NOTHING:
+        case CURLE_PARTIAL_FILE:
+        case CURLE_HTTP2:
+        case CURLE_HTTP2_STREAM:
+            return true;
+        default:
+            return false;
+    }
+}
+
+//one logical request and every attempt sent for it
+struct RetryCall {
+    AsyncRequest req;
+    bool idempotent;
+    AsyncCallback cb;
+
+    std::mutex mutex;
+    bool done;
+    int attempts;
+    int inflight;
+    std::vector<uint64_t> ids;
+    // per attempt, when it went out and whether it is still in flight
+    std::vector<uint64_t> starts;
+    std::vector<bool> open;
+    AsyncResponse last;
+};
+
+//everything the completions touch, shared so a late completion never sees a dead client
+struct CurlRetryClient::Core : std::enable_shared_from_this<CurlRetryClient::Core> {
+    AsyncCurl &client;
+    RetryOptions options;
+
+    std::mutex budgetMutex;
+    double tokens;
+
+    common::histogram latency;
+    std::mutex windowMutex;
+    std::atomic<long> hedgeDelayUs;
+
+    std::mutex rngMutex;
+    std::minstd_rand rng;
+
+    Core(AsyncCurl &client, RetryOptions options) : client(client), options(std::move(options)),
+        tokens(this -> options.budgetBurst), hedgeDelayUs(0), rng(std::random_device()()) {}
+
+    void Deposit(){
+        std::unique_lock<std::mutex> lock(budgetMutex);
+        tokens += options.budgetRatio;
+        if(tokens > options.budgetBurst)
+            tokens = options.budgetBurst;
+    }
+
+    bool Withdraw(){
+        std::unique_lock<std::mutex> lock(budgetMutex);
+        if(tokens < 1)
+            return false;
+        tokens -= 1;
+        return true;
+    }
+
+    long BackoffMs(int attempt){
+        int shift = attempt - 1 < 20 ? attempt - 1 : 20;
+        long cap = options.backoffMinMs << shift;
+        if(cap > options.backoffMaxMs || cap <= 0)
+            cap = options.backoffMaxMs;
+        std::unique_lock<std::mutex> lock(rngMutex);
+        return std::uniform_int_distribution<long>(0, cap > 0 ? cap - 1 : 0)(rng);
+    }
+
+    // every hedgeWindow attempts the quantile of that window becomes the hedge delay.
+    // fed with every attempt, losers included, so hedging can't talk the window down
+    void Record(uint64_t us){
+        latency.record(us);
+        if(latency.count() < options.hedgeWindow)
+            return;
+        std::unique_lock<std::mutex> lock(windowMutex, std::try_to_lock);
+        if(!lock.owns_lock() || latency.count() < options.hedgeWindow)
+            return;
+        long delay = (long)latency.snap().percentile(options.hedgeQuantile);
+        latency.reset();
+        if(delay < options.hedgeMinDelayMs * 1000)
+            delay = options.hedgeMinDelayMs * 1000;
+        hedgeDelayUs.store(delay, std::memory_order_relaxed);
+    }
+
+    // caller holds call -> mutex
+    void Launch(const std::shared_ptr<RetryCall> &call){
+        call -> attempts++;
+        call -> inflight++;
+        std::shared_ptr<Core> self = shared_from_this();
+        // the completion can't run before call -> mutex is released, so index it now
+        size_t k = call -> ids.size();
+        uint64_t start = NowUs();
+        uint64_t id = client.Submit(call -> req, [self, call, k](AsyncResponse &resp){
+            self -> OnResponse(call, k, resp);
+        });
+        if(id == 0){
+            call -> inflight--;
+            call -> last.code = CURLE_FAILED_INIT;
+            call -> last.error = "client not running";
+            return;
+        }
+        call -> ids.push_back(id);
+        call -> starts.push_back(start);
+        call -> open.push_back(true);
+    }
+
+    // caller holds call -> mutex, false when the request can't go out again
+    bool Retry(const std::shared_ptr<RetryCall> &call){
+        if(!call -> idempotent || call -> attempts >= options.maxAttempts || !Withdraw())
+            return false;
+        std::shared_ptr<Core> self = shared_from_this();
+        return client.Schedule(BackoffMs(call -> attempts), [self, call](){
+            std::unique_lock<std::mutex> lock(call -> mutex);
+            if(call -> done)
+                return;
+            self -> Launch(call);
+            if(call -> inflight == 0)
+                self -> Finish(call, lock);
+        });
+    }
+
+    void Hedge(const std::shared_ptr<RetryCall> &call){
+        long delay = hedgeDelayUs.load(std::memory_order_relaxed);
+        if(!options.hedge || !call -> idempotent || delay == 0)
+            return;
+        std::shared_ptr<Core> self = shared_from_this();
+        client.Schedule((delay + 999) / 1000, [self, call](){
+            std::unique_lock<std::mutex> lock(call -> mutex);
+            // only while the first attempt is still the only one out
+            if(call -> done || call -> inflight != 1 || call -> attempts != 1 || !self -> Withdraw())
+                return;
+            self -> Launch(call);
+        });
+    }
+
+    // caller holds call -> mutex through lock, the callback runs without it
+    void Finish(const std::shared_ptr<RetryCall> &call, std::unique_lock<std::mutex> &lock){
+        call -> done = true;
+        AsyncResponse resp = std::move(call -> last);
+        AsyncCallback cb = std::move(call -> cb);
+        lock.unlock();
+        if(cb)
+            cb(resp);
+    }
+
+    void OnResponse(const std::shared_ptr<RetryCall> &call, size_t k, AsyncResponse &resp){
+        std::unique_lock<std::mutex> lock(call -> mutex);
+        call -> inflight--;
+        if(call -> done)
+            return;
+        bool aborted = resp.code == CURLE_ABORTED_BY_CALLBACK;
+        uint64_t now = NowUs();
+        call -> open[k] = false;
+        if(!aborted)
+            Record(now - call -> starts[k]);
+        if(!options.retryable(resp) || aborted){
+            // a winner, cancel the attempts still racing it. a loser took at least this
+            // long, recording only the winner would hide every slow attempt a hedge beat
+            for(size_t i = 0; i < call -> ids.size(); i++){
+                if(!call -> open[i])
+                    continue;
+                if(!aborted)
+                    Record(now - call -> starts[i]);
+                call -> open[i] = false;
+                client.Cancel(call -> ids[i]);
+            }
+            call -> last = std::move(resp);
+            Finish(call, lock);
+            return;
+        }
+        call -> last = std::move(resp);
+        // a hedge is still out, let it decide
+        if(call -> inflight > 0)
+            return;
+        if(!Retry(call))
+            Finish(call, lock);
+    }
+};
+
+CurlRetryClient::CurlRetryClient(AsyncCurl &client, RetryOptions options)
+    : core(std::make_shared<Core>(client, std::move(options))){
+    if(!core -> options.retryable)
+        core -> options.retryable = DefaultRetryable;
+    if(core -> options.maxAttempts < 1)
+        core -> options.maxAttempts = 1;
+}
+
+void CurlRetryClient::Submit(AsyncRequest req, bool idempotent, AsyncCallback cb){
+    std::shared_ptr<RetryCall> call = std::make_shared<RetryCall>();
+    call -> req = std::move(req);
+    call -> idempotent = idempotent;
+    call -> cb = std::move(cb);
+    call -> done = false;
+    call -> attempts = 0;
+    call -> inflight = 0;
+
+    core -> Deposit();
+    std::unique_lock<std::mutex> lock(call -> mutex);
+    core -> Launch(call);
+    if(call -> inflight == 0){
+        core -> Finish(call, lock);
+        return;
+    }
+    core -> Hedge(call);
+}
+
+std::future<AsyncResponse> CurlRetryClient::Submit(AsyncRequest req, bool idempotent){
+    std::shared_ptr<std::promise<AsyncResponse> > p = std::make_shared<std::promise<AsyncResponse> >();
+    std::future<AsyncResponse> f = p -> get_future();
+    Submit(std::move(req), idempotent, [p](AsyncResponse &resp){ p -> set_value(std::move(resp)); });
+    return f;
+}
+
+long CurlRetryClient::HedgeDelayMs() const {
+    return (core -> hedgeDelayUs.load(std::memory_order_relaxed) + 999) / 1000;
+}
@@ -0,0 +1,64 @@
+/*************************************************************************
+    > File Name: CurlRetryClient.h
+    > Author: Jun Zhang
+    > Mail: ewalker.zj@gmail.com
+    > Created Time: Sat 17 Oct 2026 05:06:31 PM CST
+ ************************************************************************/
+
+#pragma once
+
+#include <mutex>
+#include <memory>
+#include <future>
+#include <atomic>
+#include <random>
+#include <functional>
+
+#include "AsyncCurl.h"
+#include "histogram.h"
+
+struct RetryOptions {
+    //attempts per request including the first one, retries only for idempotent requests
+    int maxAttempts;
+    //the wait before retry n is drawn uniformly from [0, min(backoffMaxMs, backoffMinMs << n))
+    long backoffMinMs;
+    long backoffMaxMs;
+    //retries and hedges together may add at most budgetRatio extra requests per request,
+    //with budgetBurst spare ones to start with, so a sick backend is not hit by a retry storm
+    double budgetRatio;
+    double budgetBurst;
+
+    //hedging: once the first attempt has been outstanding for the hedgeQuantile latency
+    //of recent attempts, an idempotent request is sent again and the first response wins
+    bool hedge;
+    double hedgeQuantile;
+    long hedgeMinDelayMs;
+    //latencies are collected in windows of this many attempts, no hedging before the first is full
+    size_t hedgeWindow;
+
+    //which failures are worth another attempt, by default connection errors,
+    //timeouts, 429 and 5xx gateway errors
+    std::function<bool(const AsyncResponse &)> retryable;
+
+    RetryOptions() : maxAttempts(3), backoffMinMs(10), backoffMaxMs(1000), budgetRatio(0.1), budgetBurst(10),
+        hedge(false), hedgeQuantile(0.95), hedgeMinDelayMs(1), hedgeWindow(200) {}
+};
+
+//retry and hedging policy on top of AsyncCurl. every request still completes exactly once:
+//with the first good response, or the last failure once attempts or budget run out.
+class CurlRetryClient {
+    public :
+        //client must be started and outlive every request sent through here
+        explicit CurlRetryClient(AsyncCurl &client, RetryOptions options = RetryOptions());
+
+        //non-idempotent requests are never retried or hedged
+        void Submit(AsyncRequest req, bool idempotent, AsyncCallback cb);
+        std::future<AsyncResponse> Submit(AsyncRequest req, bool idempotent);
+
+        //current hedge delay in ms, 0 while there is no latency window yet
+        long HedgeDelayMs() const;
+
+    private:
+        struct Core;
+        std::shared_ptr<Core> core;
+};
@@ -0,0 +1,146 @@
+/*************************************************************************
+    > File Name: CurlTimings.cpp
+    > Author: Jun Zhang
+    > Mail: ewalker.zj@gmail.com
+    > Created Time: Sat 17 Oct 2026 06:11:40 PM CST
+ ************************************************************************/
+
+#include <cstdio>
+
+#include "CurlTimings.h"
+
+static uint64_t Since(curl_off_t end, curl_off_t start){
+    return end > start ? (uint64_t)(end - start) : 0;
+}
+
+bool CurlTiming::Read(CURL *easy){
+    // libcurl reports every time from the start of the transfer, turn them into phases
+    curl_off_t dns = 0, connect = 0, tls = 0, pretransfer = 0, start = 0, total = 0, up = 0, down = 0;
+    if(curl_easy_getinfo(easy, CURLINFO_TOTAL_TIME_T, &total) != CURLE_OK)
+        return false;
+    curl_easy_getinfo(easy, CURLINFO_NAMELOOKUP_TIME_T, &dns);
+    curl_easy_getinfo(easy, CURLINFO_CONNECT_TIME_T, &connect);
+    curl_easy_getinfo(easy, CURLINFO_APPCONNECT_TIME_T, &tls);
+    curl_easy_getinfo(easy, CURLINFO_PRETRANSFER_TIME_T, &pretransfer);
+    curl_easy_getinfo(easy, CURLINFO_STARTTRANSFER_TIME_T, &start);
+    curl_easy_getinfo(easy, CURLINFO_SIZE_UPLOAD_T, &up);
+    curl_easy_getinfo(easy, CURLINFO_SIZE_DOWNLOAD_T, &down);
+
+    // appconnect stays 0 without tls
+    curl_off_t handshake = tls > 0 ? tls : connect;
+    phases[PHASE_DNS] = (uint64_t)(dns > 0 ? dns : 0);
+    phases[PHASE_CONNECT] = Since(connect, dns);
+    phases[PHASE_TLS] = tls > 0 ? Since(tls, connect) : 0;
+    phases[PHASE_PRETRANSFER] = Since(pretransfer, handshake);
+    phases[PHASE_SERVER] = Since(start, pretransfer);
+    phases[PHASE_TRANSFER] = Since(total, start);
+    phases[PHASE_TOTAL] = (uint64_t)(total > 0 ? total : 0);
+    bytesUp = (uint64_t)(up > 0 ? up : 0);
+    bytesDown = (uint64_t)(down > 0 ? down : 0);
+    return true;
+}
+
+std::string CurlTimings::HostOf(const std::string &url){
+    size_t begin = url.find("://");
+    begin = begin == std::string::npos ? 0 : begin + 3;
+    size_t end = url.find_first_of("/?#", begin);
+    if(end == std::string::npos)
+        end = url.size();
+    size_t at = url.rfind('@', end);
+    if(at != std::string::npos && at >= begin)
+        begin = at + 1;
+    return url.substr(begin, end - begin);
+}
+
+const char *CurlTimings::PhaseName(CurlPhase phase){
+    static const char *names[PHASE_COUNT] = {"dns", "connect", "tls", "pretransfer", "server", "transfer", "total"};
+    return phase >= 0 && phase < PHASE_COUNT ? names[phase] : "unknown";
+}
+
+CurlTimings::Host *CurlTimings::Find(const std::string &url){
+    std::string name = HostOf(url);
+    std::unique_lock<std::mutex> lock(mutex);
+    auto it = byName.find(name);
+    if(it != byName.end())
+        return it -> second;
+    hosts.emplace_back(new Host(name));
+    byName[name] = hosts.back().get();
+    return hosts.back().get();
+}
+
+void CurlTimings::Record(const std::string &url, CURL *easy, CURLcode code){
+    CurlTiming timing;
+    if(code != CURLE_OK || !timing.Read(easy)){
+        RecordFailure(url);
+        return;
+    }
+    Record(url, timing);
+}
+
+void CurlTimings::Record(const std::string &url, const CurlTiming &timing){
+    Host *host = Find(url);
+    host -> requests.fetch_add(1, std::memory_order_relaxed);
+    for(int i = 0; i < PHASE_COUNT; i++)
+        host -> phases[i].record(timing.phases[i]);
+    host -> bytesUp.record(timing.bytesUp);
+    host -> bytesDown.record(timing.bytesDown);
+}
+
+void CurlTimings::RecordFailure(const std::string &url){
+    Host *host = Find(url);
+    host -> requests.fetch_add(1, std::memory_order_relaxed);
+    host -> failures.fetch_add(1, std::memory_order_relaxed);
+}
+
+std::vector<CurlHostTimings> CurlTimings::Snapshot() const {
+    std::vector<Host *> all;
+    {
+        std::unique_lock<std::mutex> lock(mutex);
+        for(auto &it : hosts)
+            all.push_back(it.get());
+    }
+    std::vector<CurlHostTimings> snaps(all.size());
+    for(size_t i = 0; i < all.size(); i++){
+        CurlHostTimings &s = snaps[i];
+        s.host = all[i] -> name;
+        s.requests = all[i] -> requests.load(std::memory_order_relaxed);
+        s.failures = all[i] -> failures.load(std::memory_order_relaxed);
+        for(int p = 0; p < PHASE_COUNT; p++)
+            s.phases[p] = all[i] -> phases[p].snap();
+        s.bytesUp = all[i] -> bytesUp.snap();
+        s.bytesDown = all[i] -> bytesDown.snap();
+    }
+    return snaps;
+}
+
+void CurlTimings::Dump(std::ostream &out) const {
+    char line[256];
+    for(auto &s : Snapshot()){
+        out << s.host << " requests " << s.requests << " failures " << s.failures << "\n";
+        if(s.phases[PHASE_TOTAL].count == 0)
+            continue;
+        for(int p = 0; p < PHASE_COUNT; p++){
+            const common::histogram::snapshot &h = s.phases[p];
+            snprintf(line, sizeof(line), "  %-12s n %-8llu mean %8.3f p50 %8.3f p90 %8.3f p99 %8.3f max %8.3f ms\n",
+                    PhaseName((CurlPhase)p), (unsigned long long)h.count, h.mean() / 1000,
+                    h.percentile(0.5) / 1000.0, h.percentile(0.9) / 1000.0, h.percentile(0.99) / 1000.0, h.max / 1000.0);
+            out << line;
+        }
+        snprintf(line, sizeof(line), "  %-12s mean %.0f p99 %llu, %-6s mean %.0f p99 %llu bytes\n",
+                "up", s.bytesUp.mean(), (unsigned long long)s.bytesUp.percentile(0.99),
+                "down", s.bytesDown.mean(), (unsigned long long)s.bytesDown.percentile(0.99));
+        out << line;
+    }
+}
+
+void CurlTimings::Reset(){
+    std::unique_lock<std::mutex> lock(mutex);
+    for(auto &it : hosts){
+        it -> requests.store(0, std::memory_order_relaxed);
+        it -> failures.store(0, std::memory_order_relaxed);
+        for(int p = 0; p < PHASE_COUNT; p++)
+            it -> phases[p].reset();
+        it -> bytesUp.reset();
+        it -> bytesDown.reset();
+    }
+}
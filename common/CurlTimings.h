@@ -0,0 +1,105 @@
+/*************************************************************************
+    > File Name: CurlTimings.h
+    > Author: Jun Zhang
+    > Mail: ewalker.zj@gmail.com
+    > Created Time: Sat 17 Oct 2026 06:02:17 PM CST
+ ************************************************************************/
+
+#pragma once
+
+#include <string>
+#include <vector>
+#include <mutex>
+#include <memory>
+#include <atomic>
+#include <ostream>
+#include <unordered_map>
+#include <cstdint>
+
+#include <curl/curl.h>
+
+#include "histogram.h"
+
+//where the time of one request went, each phase starts where the previous one ended.
+//on a reused connection dns, connect and tls are 0, on plain http tls is 0
+enum CurlPhase {
+    PHASE_DNS,          //name lookup
+    PHASE_CONNECT,      //tcp handshake
+    PHASE_TLS,          //tls handshake
+    PHASE_PRETRANSFER,  //protocol setup until the first request byte could go out
+    PHASE_SERVER,       //sending the request and waiting for the first response byte
+    PHASE_TRANSFER,     //reading the rest of the response
+    PHASE_TOTAL,
+    PHASE_COUNT,
+};
+
+//the libcurl timings of one finished transfer, in microseconds
+struct CurlTiming {
+    uint64_t phases[PHASE_COUNT];
+    uint64_t bytesUp;
+    uint64_t bytesDown;
+
+    CurlTiming() : bytesUp(0), bytesDown(0) {
+        for(int i = 0; i < PHASE_COUNT; i++)
+            phases[i] = 0;
+    }
+
+    //read the timings of the transfer last run on easy
+    bool Read(CURL *easy);
+};
+
+//aggregated timings of one host
+struct CurlHostTimings {
+    std::string host;
+    uint64_t requests;
+    uint64_t failures;      //transfers that did not complete, not in the histograms
+    common::histogram::snapshot phases[PHASE_COUNT];
+    common::histogram::snapshot bytesUp;
+    common::histogram::snapshot bytesDown;
+};
+
+//per-host histograms of every phase of every request handed to Record. Curl and AsyncCurl
+//only call into it when one was set, otherwise timing costs a NULL check per request.
+//Record is safe from any number of threads, the lock is held only to find the host.
+class CurlTimings {
+    public :
+        CurlTimings() {}
+
+        //url is the one the request was sent to, only its host:port is kept
+        void Record(const std::string &url, CURL *easy, CURLcode code);
+        void Record(const std::string &url, const CurlTiming &timing);
+        void RecordFailure(const std::string &url);
+
+        //hosts in the order they were first seen
+        std::vector<CurlHostTimings> Snapshot() const;
+        //one line per host and phase with count, mean, p50, p90, p99 and max in ms
+        void Dump(std::ostream &out) const;
+        //zero every histogram, hosts stay known
+        void Reset();
+
+        static const char *PhaseName(CurlPhase phase);
+        //host[:port] of url, without scheme, credentials and path
+        static std::string HostOf(const std::string &url);
+
+    private:
+        CurlTimings(const CurlTimings &) = delete;
+        CurlTimings &operator=(const CurlTimings &) = delete;
+
+        struct Host {
+            std::string name;
+            std::atomic<uint64_t> requests;
+            std::atomic<uint64_t> failures;
+            common::histogram phases[PHASE_COUNT];
+            common::histogram bytesUp;
+            common::histogram bytesDown;
+
+            Host(const std::string &name) : name(name), requests(0), failures(0) {}
+        };
+
+        Host *Find(const std::string &url);
+
+        mutable std::mutex mutex;
+        std::unordered_map<std::string, Host *> byName;
+        //owns the hosts, they never move or go away so Record can use them unlocked
+        std::vector<std::unique_ptr<Host> > hosts;
+};
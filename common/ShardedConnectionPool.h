@@ -0,0 +1,233 @@
+#pragma once
+
+#ifndef __TML_SHARDED_CONNECTION_POOL_INC__
+#define __TML_SHARDED_CONNECTION_POOL_INC__
+
+#include <mutex>
+#include <queue>
+#include <atomic>
+#include <chrono>
+#include <memory>
+#include <thread>
+#include <vector>
+#include <condition_variable>
+
+namespace common {
+
+//connection_pool for many request threads.
+//every thread owns a cache slot holding the connection it used last, so a thread
+//that keeps doing get/put_back only ever touches its own slot with one atomic exchange.
+//behind the slots the idle connections are spread over shards with their own lock;
+//a thread tries its home shard first and steals from the others when it runs dry.
+//the shared wait lock is only taken when nothing is idle anywhere.
+template<typename T>
+class sharded_connection_pool {
+public:
+    //auto_reconnect default true if you don't want auto connect, pass false
+    explicit sharded_connection_pool(size_t shard_count = std::thread::hardware_concurrency(), bool auto_reconnect = true)
+        : shards(shard_count ? shard_count : 1), slots(round_up(shards.size() * 4)), next_shard(0), waiters(0), stopping(false) {
+        if (auto_reconnect) {
+            reconnector = std::thread(&sharded_connection_pool::reconnect, this);
+        }
+    }
+
+    sharded_connection_pool(const sharded_connection_pool &) = delete;
+    sharded_connection_pool &operator=(const sharded_connection_pool &) = delete;
+
+    ~sharded_connection_pool() {
+        {
+            std::unique_lock<std::mutex> lock(bad_mutex);
+            stopping = true;
+            bad_cond.notify_all();
+        }
+        if (reconnector.joinable()) {
+            reconnector.join();
+        }
+    }
+
+    //add a connection to pool
+    bool add(T *conn) {
+        shard &s = shards[next_shard.fetch_add(1, std::memory_order_relaxed) % shards.size()];
+        {
+            std::unique_lock<std::mutex> lock(s.mutex);
+            s.idle.push_back(conn);
+        }
+        wake_waiter();
+        return true;
+    }
+
+    //get a connection from pool, timeout in ms, <= 0 waits forever
+    T* get(int timeout = 0) {
+        T *conn = try_get();
+        if (conn) {
+            return conn;
+        }
+        auto deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(timeout);
+        std::unique_lock<std::mutex> lock(wait_mutex);
+        waiters.fetch_add(1, std::memory_order_seq_cst);
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        while (!(conn = try_get())) {
+            if (timeout > 0) {
+                if (std::cv_status::timeout == cond.wait_until(lock, deadline)) {
+                    conn = try_get();
+                    break;
+                }
+            } else {
+                cond.wait(lock);
+            }
+        }
+        waiters.fetch_sub(1, std::memory_order_relaxed);
+        return conn;
+    }
+
+    //put a connection back to pool
+    bool put_back(T *conn) {
+        if (waiters.load(std::memory_order_relaxed) == 0) {
+            T *expected = NULL;
+            if (local_slot().conn.compare_exchange_strong(expected, conn, std::memory_order_seq_cst)) {
+                //a thread may have started waiting after the check above, it rescans
+                //the slots once woken, so a cached connection never strands it
+                wake_waiter();
+                return true;
+            }
+        }
+        shard &s = home_shard();
+        {
+            std::unique_lock<std::mutex> lock(s.mutex);
+            s.idle.push_back(conn);
+        }
+        wake_waiter();
+        return true;
+    }
+
+    //mark a connection as invalid
+    bool mark_invalid(T *conn) {
+        std::unique_lock<std::mutex> lock(bad_mutex);
+        bad.push(conn);
+        bad_cond.notify_one();
+        return true;
+    }
+
+private:
+    static const size_t CACHE_LINE = 64;
+
+    struct alignas(CACHE_LINE) shard {
+        std::mutex mutex;
+        std::vector<T *> idle;
+    };
+
+    struct alignas(CACHE_LINE) slot {
+        slot() : conn(NULL) {
+        }
+        std::atomic<T *> conn;
+    };
+
+    static size_t round_up(size_t n) {
+        size_t r = 1;
+        while (r < n) {
+            r <<= 1;
+        }
+        return r;
+    }
+
+    //small dense id per thread, shared by every pool instance
+    static size_t thread_ordinal() {
+        static std::atomic<size_t> next(0);
+        static thread_local size_t id = next.fetch_add(1, std::memory_order_relaxed);
+        return id;
+    }
+
+    slot &local_slot() {
+        return slots[thread_ordinal() & (slots.size() - 1)];
+    }
+
+    shard &home_shard() {
+        return shards[thread_ordinal() % shards.size()];
+    }
+
+    void wake_waiter() {
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        if (waiters.load(std::memory_order_relaxed) > 0) {
+            std::unique_lock<std::mutex> lock(wait_mutex);
+            cond.notify_one();
+        }
+    }
+
+    static T* pop_idle(shard &s) {
+        if (s.idle.empty()) {
+            return NULL;
+        }
+        T *conn = s.idle.back();
+        s.idle.pop_back();
+        return conn;
+    }
+
+    //own slot, home shard, then steal from other shards and other threads' slots
+    T* try_get() {
+        T *conn = local_slot().conn.exchange(NULL, std::memory_order_acquire);
+        if (conn) {
+            return conn;
+        }
+        size_t home = thread_ordinal() % shards.size();
+        {
+            std::unique_lock<std::mutex> lock(shards[home].mutex);
+            if ((conn = pop_idle(shards[home]))) {
+                return conn;
+            }
+        }
+        for (size_t i = 1; i < shards.size(); i++) {
+            shard &s = shards[(home + i) % shards.size()];
+            std::unique_lock<std::mutex> lock(s.mutex);
+            if ((conn = pop_idle(s))) {
+                return conn;
+            }
+        }
+        for (size_t i = 0; i < slots.size(); i++) {
+            if (slots[i].conn.load(std::memory_order_relaxed) &&
+                    (conn = slots[i].conn.exchange(NULL, std::memory_order_acquire))) {
+                return conn;
+            }
+        }
+        return NULL;
+    }
+
+    //auto reconnect in a seperate thread, sleeps until a connection is marked invalid
+    void reconnect() {
+        std::unique_lock<std::mutex> lock(bad_mutex);
+        while (!stopping) {
+            if (bad.empty()) {
+                bad_cond.wait(lock);
+                continue;
+            }
+            T *conn = bad.front();
+            bad.pop();
+            lock.unlock();
+            bool ok = conn->reconnect();
+            if (ok) {
+                add(conn);
+            }
+            lock.lock();
+            if (!ok) {
+                bad.push(conn);
+                bad_cond.wait_for(lock, std::chrono::milliseconds(100));
+            }
+        }
+    }
+
+    std::vector<shard> shards;
+    std::vector<slot> slots;
+    std::atomic<size_t> next_shard;
+    std::atomic<int> waiters;
+    std::mutex wait_mutex;
+    std::condition_variable cond;
+
+    std::queue<T *> bad;
+    bool stopping;
+    std::mutex bad_mutex;
+    std::condition_variable bad_cond;
+    std::thread reconnector;
+};
+
+}
+
+#endif //__TML_SHARDED_CONNECTION_POOL_INC__
@@ -0,0 +1,81 @@
+#pragma once
+
+#ifndef __TML_CORO_INC__
+#define __TML_CORO_INC__
+
+//C++20 coroutine support for the concurrency primitives.
+//everything here compiles away when the compiler has no coroutines,
+//task_queue and connection_pool check TML_HAS_COROUTINES before exposing awaitables.
+
+#if defined(__cpp_impl_coroutine) && defined(__has_include)
+#if __has_include(<coroutine>)
+#define TML_HAS_COROUTINES 1
+#endif
+#endif
+
+#ifndef TML_HAS_COROUTINES
+#define TML_HAS_COROUTINES 0
+#endif
+
+#if TML_HAS_COROUTINES
+
+#include <coroutine>
+#include <exception>
+
+namespace common {
+namespace coro {
+
+//where suspended coroutines get resumed. awaitables never resume inline
+//under their own lock, they hand the handle to the waiter's scheduler.
+class scheduler {
+public:
+    virtual ~scheduler() {
+    }
+
+    virtual void schedule(std::coroutine_handle<> h) = 0;
+
+    struct schedule_awaiter {
+        scheduler *s;
+        bool await_ready() const noexcept {
+            return false;
+        }
+        void await_suspend(std::coroutine_handle<> h) {
+            s->schedule(h);
+        }
+        void await_resume() const noexcept {
+        }
+    };
+
+    //co_await sched.hop() continues the coroutine on this scheduler
+    schedule_awaiter hop() {
+        return schedule_awaiter{this};
+    }
+};
+
+//fire-and-forget coroutine, starts running inline and frees itself when it finishes.
+//start with co_await sched.hop() to move onto a scheduler.
+struct task {
+    struct promise_type {
+        task get_return_object() noexcept {
+            return task();
+        }
+        std::suspend_never initial_suspend() noexcept {
+            return {};
+        }
+        std::suspend_never final_suspend() noexcept {
+            return {};
+        }
+        void return_void() noexcept {
+        }
+        void unhandled_exception() noexcept {
+            std::terminate();
+        }
+    };
+};
+
+}
+}
+
+#endif //TML_HAS_COROUTINES
+
+#endif //__TML_CORO_INC__
@@ -0,0 +1,73 @@
+#pragma once
+
+#ifndef __TML_CORO_SCHEDULER_INC__
+#define __TML_CORO_SCHEDULER_INC__
+
+#include "coro.h"
+
+#if TML_HAS_COROUTINES
+
+#include <atomic>
+#include <thread>
+
+#include "thread_pool.h"
+#include "value_queue.h"
+
+namespace common {
+namespace coro {
+
+//runs coroutines on the thread that calls run()
+class single_thread_scheduler : public scheduler {
+public:
+    single_thread_scheduler() : ready(1024), stopped(false) {
+    }
+
+    void schedule(std::coroutine_handle<> h) override {
+        ready.push(h);
+    }
+
+    //resume coroutines until stop() is called
+    void run() {
+        std::coroutine_handle<> h;
+        while (!stopped.load()) {
+            if (ready.pop(h, 100) && h) {
+                h.resume();
+            }
+        }
+    }
+
+    void stop() {
+        stopped.store(true);
+        ready.push(std::coroutine_handle<>());
+    }
+
+private:
+    value_queue<std::coroutine_handle<> > ready;
+    std::atomic<bool> stopped;
+};
+
+//runs coroutines on a work-stealing thread_pool, a coroutine may resume on any worker
+class pool_scheduler : public scheduler {
+public:
+    explicit pool_scheduler(size_t threads = std::thread::hardware_concurrency()) : pool(threads) {
+    }
+
+    void schedule(std::coroutine_handle<> h) override {
+        pool.submit([h]() { h.resume(); });
+    }
+
+    //block until no coroutine is runnable
+    void wait() {
+        pool.wait();
+    }
+
+private:
+    thread_pool pool;
+};
+
+}
+}
+
+#endif //TML_HAS_COROUTINES
+
+#endif //__TML_CORO_SCHEDULER_INC__
@@ -0,0 +1,110 @@
+#pragma once
+
+#ifndef __TML_EVENT_COUNT_INC__
+#define __TML_EVENT_COUNT_INC__
+
+#include <mutex>
+#include <atomic>
+#include <chrono>
+#include <thread>
+#include <condition_variable>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#endif
+
+namespace common {
+
+inline void cpu_relax() {
+#if defined(__x86_64__) || defined(__i386__)
+    _mm_pause();
+#elif defined(__aarch64__)
+    asm volatile("yield" ::: "memory");
+#else
+    std::this_thread::yield();
+#endif
+}
+
+//wait without parking: spin, then yield the cpu between checks until ready() or the timeout.
+//timeout in ms, <= 0 waits forever. returns false on timeout.
+//the notifying side needs no fence and no shared counter, at the price of a busy waiter
+template<typename Pred>
+bool spin_until(Pred ready, int timeout = 0, int spin = 128) {
+    for (int i = 0; i < spin; i++) {
+        if (ready()) {
+            return true;
+        }
+        cpu_relax();
+    }
+    auto deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(timeout);
+    while (!ready()) {
+        if (timeout > 0 && std::chrono::steady_clock::now() >= deadline) {
+            return ready();
+        }
+        std::this_thread::yield();
+    }
+    return true;
+}
+
+//spin-then-park helper for lock-free containers.
+//notify() is a single atomic load when nobody is parked, so busy
+//producers and consumers never touch the mutex or the futex behind it.
+class event_count {
+public:
+    event_count() : waiters(0) {
+    }
+
+    void notify_one() {
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        if (waiters.load(std::memory_order_relaxed) > 0) {
+            std::unique_lock<std::mutex> lock(mutex);
+            cond.notify_one();
+        }
+    }
+
+    void notify_all() {
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        if (waiters.load(std::memory_order_relaxed) > 0) {
+            std::unique_lock<std::mutex> lock(mutex);
+            cond.notify_all();
+        }
+    }
+
+    //wait until ready() returns true, spinning for `spin` rounds before parking.
+    //timeout in ms, <= 0 waits forever. returns false on timeout.
+    template<typename Pred>
+    bool wait(Pred ready, int timeout = 0, int spin = 128) {
+        for (int i = 0; i < spin; i++) {
+            if (ready()) {
+                return true;
+            }
+            cpu_relax();
+        }
+        auto deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(timeout);
+        std::unique_lock<std::mutex> lock(mutex);
+        waiters.fetch_add(1, std::memory_order_seq_cst);
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        bool ok = true;
+        while (!ready()) {
+            if (timeout > 0) {
+                if (std::cv_status::timeout == cond.wait_until(lock, deadline)) {
+                    ok = ready();
+                    break;
+                }
+            } else {
+                cond.wait(lock);
+            }
+        }
+        waiters.fetch_sub(1, std::memory_order_relaxed);
+        return ok;
+    }
+
+private:
+    std::atomic<int> waiters;
+    std::mutex mutex;
+    std::condition_variable cond;
+};
+
+}
+
+#endif //__TML_EVENT_COUNT_INC__
@@ -0,0 +1,144 @@
+#pragma once
+
+#ifndef __TML_HISTOGRAM_INC__
+#define __TML_HISTOGRAM_INC__
+
+#include <atomic>
+#include <vector>
+#include <cstddef>
+#include <cstdint>
+
+namespace common {
+
+//lock-free log-linear histogram for latencies and sizes.
+//every power of two is split into SUB_BUCKETS linear buckets, so any recorded
+//value is reported within 1/SUB_BUCKETS (~6%) of its true value.
+//record() is a couple of relaxed atomic adds, safe from any number of threads.
+class histogram {
+public:
+    static const int SUB_BITS = 4;
+    static const size_t SUB_BUCKETS = 1 << SUB_BITS;
+    static const size_t BUCKETS = (64 - SUB_BITS + 1) * SUB_BUCKETS;
+
+    struct snapshot {
+        uint64_t count;
+        uint64_t sum;
+        uint64_t max;
+        std::vector<uint64_t> buckets;
+
+        snapshot() : count(0), sum(0), max(0) {
+        }
+
+        double mean() const {
+            return count ? (double)sum / count : 0.0;
+        }
+
+        //value at quantile q in [0, 1], e.g. 0.99 for p99
+        uint64_t percentile(double q) const {
+            if (count == 0) {
+                return 0;
+            }
+            uint64_t rank = (uint64_t)(q * count);
+            if (rank >= count) {
+                rank = count - 1;
+            }
+            uint64_t seen = 0;
+            for (size_t i = 0; i < buckets.size(); i++) {
+                seen += buckets[i];
+                if (seen > rank) {
+                    uint64_t v = bucket_upper(i);
+                    return v < max ? v : max;
+                }
+            }
+            return max;
+        }
+
+        //accumulate another snapshot, e.g. to merge per-shard histograms
+        void merge(const snapshot &o) {
+            if (buckets.size() < o.buckets.size()) {
+                buckets.resize(o.buckets.size(), 0);
+            }
+            for (size_t i = 0; i < o.buckets.size(); i++) {
+                buckets[i] += o.buckets[i];
+            }
+            count += o.count;
+            sum += o.sum;
+            if (o.max > max) {
+                max = o.max;
+            }
+        }
+    };
+
+    histogram() : total(0), total_sum(0), max_value(0) {
+        for (size_t i = 0; i < BUCKETS; i++) {
+            counts[i].store(0, std::memory_order_relaxed);
+        }
+    }
+
+    histogram(const histogram &) = delete;
+    histogram &operator=(const histogram &) = delete;
+
+    void record(uint64_t v) {
+        counts[bucket_of(v)].fetch_add(1, std::memory_order_relaxed);
+        total.fetch_add(1, std::memory_order_relaxed);
+        total_sum.fetch_add(v, std::memory_order_relaxed);
+        uint64_t m = max_value.load(std::memory_order_relaxed);
+        while (v > m && !max_value.compare_exchange_weak(m, v, std::memory_order_relaxed)) {
+        }
+    }
+
+    //counters are read one by one, a snapshot taken under load may be off by in-flight records
+    snapshot snap() const {
+        snapshot s;
+        s.buckets.resize(BUCKETS);
+        for (size_t i = 0; i < BUCKETS; i++) {
+            s.buckets[i] = counts[i].load(std::memory_order_relaxed);
+            s.count += s.buckets[i];
+        }
+        s.sum = total_sum.load(std::memory_order_relaxed);
+        s.max = max_value.load(std::memory_order_relaxed);
+        return s;
+    }
+
+    void reset() {
+        for (size_t i = 0; i < BUCKETS; i++) {
+            counts[i].store(0, std::memory_order_relaxed);
+        }
+        total.store(0, std::memory_order_relaxed);
+        total_sum.store(0, std::memory_order_relaxed);
+        max_value.store(0, std::memory_order_relaxed);
+    }
+
+    uint64_t count() const {
+        return total.load(std::memory_order_relaxed);
+    }
+
+    static size_t bucket_of(uint64_t v) {
+        if (v < SUB_BUCKETS) {
+            return (size_t)v;
+        }
+        int msb = 63 - __builtin_clzll(v);
+        int shift = msb - SUB_BITS;
+        return (size_t)(shift + 1) * SUB_BUCKETS + (size_t)((v >> shift) & (SUB_BUCKETS - 1));
+    }
+
+    //largest value that falls into bucket i
+    static uint64_t bucket_upper(size_t i) {
+        if (i < SUB_BUCKETS) {
+            return i;
+        }
+        int shift = (int)(i / SUB_BUCKETS) - 1;
+        uint64_t base = ((uint64_t)SUB_BUCKETS | (i % SUB_BUCKETS)) << shift;
+        return base + ((uint64_t)1 << shift) - 1;
+    }
+
+private:
+    std::atomic<uint64_t> counts[BUCKETS];
+    std::atomic<uint64_t> total;
+    std::atomic<uint64_t> total_sum;
+    std::atomic<uint64_t> max_value;
+};
+
+}
+
+#endif //__TML_HISTOGRAM_INC__
@@ -0,0 +1,125 @@
+#pragma once
+
+#ifndef __TML_LOCKFREE_QUEUE_INC__
+#define __TML_LOCKFREE_QUEUE_INC__
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "event_count.h"
+
+namespace common {
+
+//bounded lock-free MPMC ring buffer (Vyukov), drop-in for task_queue on hot paths.
+//push never blocks and returns false when the ring is full,
+//pop spins briefly and then parks until an item arrives or timeout expires.
+template<typename T>
+class lockfree_queue {
+public:
+    //capacity is rounded up to a power of two
+    explicit lockfree_queue(size_t capacity = 1024) : cells(round_up(capacity)), mask(cells.size() - 1) {
+        for (size_t i = 0; i < cells.size(); i++) {
+            cells[i].seq.store(i, std::memory_order_relaxed);
+        }
+        enqueue_pos.store(0, std::memory_order_relaxed);
+        dequeue_pos.store(0, std::memory_order_relaxed);
+    }
+
+    lockfree_queue(const lockfree_queue &) = delete;
+    lockfree_queue &operator=(const lockfree_queue &) = delete;
+
+    bool push(T *t) {
+        if (!try_push(t)) {
+            return false;
+        }
+        not_empty.notify_one();
+        return true;
+    }
+
+    //timeout in ms, <= 0 waits forever. returns NULL on timeout
+    T* pop(int timeout = 0) {
+        T *t = try_pop();
+        if (t) {
+            return t;
+        }
+        not_empty.wait([&]() { return (t = try_pop()) != NULL; }, timeout);
+        return t;
+    }
+
+    bool try_push(T *t) {
+        cell *c;
+        size_t pos = enqueue_pos.load(std::memory_order_relaxed);
+        for (;;) {
+            c = &cells[pos & mask];
+            size_t seq = c->seq.load(std::memory_order_acquire);
+            intptr_t diff = (intptr_t)seq - (intptr_t)pos;
+            if (diff == 0) {
+                if (enqueue_pos.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) {
+                    break;
+                }
+            } else if (diff < 0) {
+                return false;
+            } else {
+                pos = enqueue_pos.load(std::memory_order_relaxed);
+            }
+        }
+        c->data = t;
+        c->seq.store(pos + 1, std::memory_order_release);
+        return true;
+    }
+
+    T* try_pop() {
+        cell *c;
+        size_t pos = dequeue_pos.load(std::memory_order_relaxed);
+        for (;;) {
+            c = &cells[pos & mask];
+            size_t seq = c->seq.load(std::memory_order_acquire);
+            intptr_t diff = (intptr_t)seq - (intptr_t)(pos + 1);
+            if (diff == 0) {
+                if (dequeue_pos.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) {
+                    break;
+                }
+            } else if (diff < 0) {
+                return NULL;
+            } else {
+                pos = dequeue_pos.load(std::memory_order_relaxed);
+            }
+        }
+        T *t = c->data;
+        c->seq.store(pos + mask + 1, std::memory_order_release);
+        return t;
+    }
+
+    size_t capacity() const {
+        return cells.size();
+    }
+
+private:
+    static const size_t CACHE_LINE = 64;
+
+    struct cell {
+        std::atomic<size_t> seq;
+        T *data;
+    };
+
+    static size_t round_up(size_t n) {
+        size_t r = 2;
+        while (r < n) {
+            r <<= 1;
+        }
+        return r;
+    }
+
+    std::vector<cell> cells;
+    const size_t mask;
+    //producers and consumers hammer different indexes, keep them on separate lines
+    alignas(CACHE_LINE) std::atomic<size_t> enqueue_pos;
+    alignas(CACHE_LINE) std::atomic<size_t> dequeue_pos;
+    alignas(CACHE_LINE) event_count not_empty;
+};
+
+}
+
+#endif //__TML_LOCKFREE_QUEUE_INC__
@@ -0,0 +1,138 @@
+#pragma once
+
+#ifndef __TML_POOL_STATS_INC__
+#define __TML_POOL_STATS_INC__
+
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+
+#include "histogram.h"
+
+namespace common {
+
+//connection counts the pool fills in under its own lock when a snapshot is taken
+struct pool_gauges {
+    uint64_t total;     //every connection the pool knows about
+    uint64_t idle;
+    uint64_t in_use;    //leased out
+    uint64_t bad;       //waiting for reconnect
+    uint64_t waiting;   //callers blocked or suspended in get/async_acquire
+
+    pool_gauges() : total(0), idle(0), in_use(0), bad(0), waiting(0) {
+    }
+};
+
+//instrumentation policies for connection_pool, picked as the second template argument:
+//  connection_pool<T>                  no_pool_stats, only the gauges, hooks compile to nothing
+//  connection_pool<T, pool_stats>      plus wait and lease histograms, timeout and reconnect counters
+//every slot carries a Stats::stamp of when it was leased, an empty base when stats are off.
+struct no_pool_stats {
+    struct stamp {
+    };
+
+    struct snapshot : pool_gauges {
+    };
+
+    static stamp now() {
+        return stamp();
+    }
+
+    //a lease was handed out to a caller that started asking at wait_start
+    void on_acquire(const stamp &) {
+    }
+
+    //a lease handed out at leased came back
+    void on_release(const stamp &) {
+    }
+
+    void on_timeout() {
+    }
+
+    void on_reconnect(bool) {
+    }
+
+    snapshot snap() const {
+        return snapshot();
+    }
+};
+
+class pool_stats {
+public:
+    struct stamp {
+        uint64_t ns;
+    };
+
+    struct snapshot : pool_gauges {
+        uint64_t time_ns;       //steady clock when the snapshot was taken
+        uint64_t acquires;
+        uint64_t timeouts;
+        uint64_t reconnects;
+        uint64_t reconnect_failures;
+        histogram::snapshot wait_ns;    //time from asking to holding a lease, 0-ish when one was idle
+        histogram::snapshot lease_ns;   //time a caller held a connection
+
+        //leases handed out per second between an older snapshot and this one
+        double acquire_rate(const snapshot &prev) const {
+            uint64_t dt = time_ns - prev.time_ns;
+            return dt ? (acquires - prev.acquires) * 1e9 / dt : 0.0;
+        }
+    };
+
+    pool_stats() : acquires(0), timeouts(0), reconnects(0), reconnect_failures(0) {
+    }
+
+    static stamp now() {
+        stamp s;
+        s.ns = (uint64_t)std::chrono::duration_cast<std::chrono::nanoseconds>(
+            std::chrono::steady_clock::now().time_since_epoch()).count();
+        return s;
+    }
+
+    void on_acquire(const stamp &wait_start) {
+        acquires.fetch_add(1, std::memory_order_relaxed);
+        wait.record(elapsed(wait_start));
+    }
+
+    void on_release(const stamp &leased) {
+        lease.record(elapsed(leased));
+    }
+
+    void on_timeout() {
+        timeouts.fetch_add(1, std::memory_order_relaxed);
+    }
+
+    void on_reconnect(bool ok) {
+        (ok ? reconnects : reconnect_failures).fetch_add(1, std::memory_order_relaxed);
+    }
+
+    snapshot snap() const {
+        snapshot s;
+        s.time_ns = now().ns;
+        s.acquires = acquires.load(std::memory_order_relaxed);
+        s.timeouts = timeouts.load(std::memory_order_relaxed);
+        s.reconnects = reconnects.load(std::memory_order_relaxed);
+        s.reconnect_failures = reconnect_failures.load(std::memory_order_relaxed);
+        s.wait_ns = wait.snap();
+        s.lease_ns = lease.snap();
+        return s;
+    }
+
+private:
+    static uint64_t elapsed(const stamp &from) {
+        uint64_t t = now().ns;
+        return t > from.ns ? t - from.ns : 0;
+    }
+
+    std::atomic<uint64_t> acquires;
+    std::atomic<uint64_t> timeouts;
+    std::atomic<uint64_t> reconnects;
+    std::atomic<uint64_t> reconnect_failures;
+    histogram wait;
+    histogram lease;
+};
+
+}
+
+#endif //__TML_POOL_STATS_INC__
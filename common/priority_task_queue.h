@@ -0,0 +1,147 @@
+#pragma once
+
+#ifndef __TML_PRIORITY_TASK_QUEUE_INC__
+#define __TML_PRIORITY_TASK_QUEUE_INC__
+
+#include <mutex>
+#include <queue>
+#include <vector>
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <condition_variable>
+
+namespace common {
+
+//task_queue that pops the most urgent task first, O(log n) per push/pop.
+//higher priority class wins, within a class the earliest deadline wins,
+//ties keep FIFO order. tasks without a deadline sort after those with one.
+template<typename T>
+class priority_task_queue {
+public:
+    typedef std::chrono::steady_clock clock;
+
+    //on_expired, if set, receives tasks whose deadline passed before they were popped,
+    //instead of handing them to a worker. leave it empty to never drop tasks.
+    explicit priority_task_queue(std::function<void(T *)> on_expired = nullptr) : seq(0), on_expired(on_expired) {
+    }
+
+    bool push(T *t, int priority = 0) {
+        return push_until(t, clock::time_point::max(), priority);
+    }
+
+    //absolute deadline, tasks still queued after it are dropped when on_expired is set
+    bool push_until(T *t, clock::time_point deadline, int priority = 0) {
+        std::unique_lock<std::mutex> lock(mutex);
+        entry e = { t, priority, deadline, seq++ };
+        tasks.push(e);
+        cond.notify_one();
+        return true;
+    }
+
+    //timeout in ms, <= 0 waits forever. returns NULL on timeout
+    T* pop(int timeout = 0) {
+        std::vector<T *> expired;
+        T *t = NULL;
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            auto deadline = clock::now() + std::chrono::milliseconds(timeout);
+            while (true) {
+                drop_expired(expired);
+                if (!tasks.empty()) {
+                    t = tasks.top().task;
+                    tasks.pop();
+                    break;
+                }
+                //don't sit on dropped tasks while blocked, a push may be hours away
+                if (!expired.empty()) {
+                    run_expired(lock, expired);
+                    continue;
+                }
+                if (timeout > 0) {
+                    if (std::cv_status::timeout == cond.wait_until(lock, deadline)) {
+                        drop_expired(expired);
+                        if (!tasks.empty()) {
+                            t = tasks.top().task;
+                            tasks.pop();
+                        }
+                        break;
+                    }
+                } else {
+                    cond.wait(lock);
+                }
+            }
+        }
+        //run the handler outside the lock, it may well delete or requeue
+        for (size_t i = 0; i < expired.size(); i++) {
+            on_expired(expired[i]);
+        }
+        return t;
+    }
+
+    size_t size() {
+        std::unique_lock<std::mutex> lock(mutex);
+        return tasks.size();
+    }
+
+private:
+    struct entry {
+        T *task;
+        int priority;
+        clock::time_point deadline;
+        uint64_t seq;
+    };
+
+    //std::priority_queue is a max-heap, so "less" means "less urgent"
+    struct less_urgent {
+        bool operator()(const entry &a, const entry &b) const {
+            if (a.priority != b.priority) {
+                return a.priority < b.priority;
+            }
+            if (a.deadline != b.deadline) {
+                return a.deadline > b.deadline;
+            }
+            return a.seq > b.seq;
+        }
+    };
+
+    //caller holds the lock, which is dropped while the handler runs
+    void run_expired(std::unique_lock<std::mutex> &lock, std::vector<T *> &expired) {
+        lock.unlock();
+        for (size_t i = 0; i < expired.size(); i++) {
+            on_expired(expired[i]);
+        }
+        expired.clear();
+        lock.lock();
+    }
+
+    //caller holds the lock
+    void drop_expired(std::vector<T *> &expired) {
+        if (!on_expired) {
+            return;
+        }
+        clock::time_point now;
+        bool have_now = false;
+        while (!tasks.empty() && tasks.top().deadline != clock::time_point::max()) {
+            if (!have_now) {
+                now = clock::now();
+                have_now = true;
+            }
+            if (tasks.top().deadline >= now) {
+                break;
+            }
+            expired.push_back(tasks.top().task);
+            tasks.pop();
+        }
+    }
+
+    std::priority_queue<entry, std::vector<entry>, less_urgent> tasks;
+    uint64_t seq;
+    std::function<void(T *)> on_expired;
+    std::mutex mutex;
+    std::condition_variable cond;
+};
+
+}
+
+#endif //__TML_PRIORITY_TASK_QUEUE_INC__
@@ -0,0 +1,127 @@
+#pragma once
+
+#ifndef __TML_QUEUE_STATS_INC__
+#define __TML_QUEUE_STATS_INC__
+
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+
+#include "histogram.h"
+
+namespace common {
+
+//instrumentation policies for task_queue, picked as the last template argument:
+//  task_queue<T>                          no_queue_stats, every hook compiles to nothing
+//  task_queue<T, mpmc, queue_stats>       depth, rates, wait and sojourn histograms
+//every queued task carries a Stats::stamp, which is an empty base when stats are off.
+struct no_queue_stats {
+    struct stamp {
+    };
+
+    static stamp now() {
+        return stamp();
+    }
+
+    void on_push(size_t) {
+    }
+
+    void on_pop(const stamp &) {
+    }
+
+    void on_wait(const stamp &) {
+    }
+};
+
+class queue_stats {
+public:
+    struct stamp {
+        uint64_t ns;
+    };
+
+    struct snapshot {
+        uint64_t time_ns;       //steady clock when the snapshot was taken
+        uint64_t depth;
+        uint64_t high_water;
+        uint64_t pushes;
+        uint64_t pops;
+        histogram::snapshot wait_ns;    //time consumers spent blocked in pop
+        histogram::snapshot sojourn_ns; //enqueue to dequeue time per task
+
+        //pushes per second between an older snapshot and this one
+        double push_rate(const snapshot &prev) const {
+            return per_second(pushes - prev.pushes, prev);
+        }
+
+        double pop_rate(const snapshot &prev) const {
+            return per_second(pops - prev.pops, prev);
+        }
+
+    private:
+        double per_second(uint64_t n, const snapshot &prev) const {
+            uint64_t dt = time_ns - prev.time_ns;
+            return dt ? n * 1e9 / dt : 0.0;
+        }
+    };
+
+    queue_stats() : depth(0), high_water(0), pushes(0), pops(0) {
+    }
+
+    static stamp now() {
+        stamp s;
+        s.ns = (uint64_t)std::chrono::duration_cast<std::chrono::nanoseconds>(
+            std::chrono::steady_clock::now().time_since_epoch()).count();
+        return s;
+    }
+
+    void on_push(size_t n) {
+        pushes.fetch_add(n, std::memory_order_relaxed);
+        int64_t d = depth.fetch_add((int64_t)n, std::memory_order_relaxed) + (int64_t)n;
+        int64_t m = high_water.load(std::memory_order_relaxed);
+        while (d > m && !high_water.compare_exchange_weak(m, d, std::memory_order_relaxed)) {
+        }
+    }
+
+    void on_pop(const stamp &enqueued) {
+        pops.fetch_add(1, std::memory_order_relaxed);
+        depth.fetch_sub(1, std::memory_order_relaxed);
+        sojourn.record(elapsed(enqueued));
+    }
+
+    //called once a blocked pop returns, with the time it started waiting
+    void on_wait(const stamp &start) {
+        wait.record(elapsed(start));
+    }
+
+    snapshot snap() const {
+        snapshot s;
+        s.time_ns = now().ns;
+        //lock-free queues may count a pop before the matching push, never report below zero
+        int64_t d = depth.load(std::memory_order_relaxed);
+        s.depth = d > 0 ? (uint64_t)d : 0;
+        s.high_water = (uint64_t)high_water.load(std::memory_order_relaxed);
+        s.pushes = pushes.load(std::memory_order_relaxed);
+        s.pops = pops.load(std::memory_order_relaxed);
+        s.wait_ns = wait.snap();
+        s.sojourn_ns = sojourn.snap();
+        return s;
+    }
+
+private:
+    static uint64_t elapsed(const stamp &from) {
+        uint64_t t = now().ns;
+        return t > from.ns ? t - from.ns : 0;
+    }
+
+    std::atomic<int64_t> depth;
+    std::atomic<int64_t> high_water;
+    std::atomic<uint64_t> pushes;
+    std::atomic<uint64_t> pops;
+    histogram wait;
+    histogram sojourn;
+};
+
+}
+
+#endif //__TML_QUEUE_STATS_INC__
@@ -5,49 +5,719 @@
 
 #include <mutex>
 #include <queue>
+#include <vector>
+#include <atomic>
+#include <cstddef>
 #include <thread>
 #include <condition_variable>
 
+#include "event_count.h"
+#include "queue_stats.h"
+#include "coro.h"
+
 namespace common {
 
-template<typename T>
+//producer/consumer policies, switch implementation with a single type change:
+//  task_queue<T>        any number of producers and consumers, mutex + condvar
+//  task_queue<T, mpsc>  many producers, one consumer, lock-free linked list
+//  task_queue<T, spsc>  one producer, one consumer, bounded wait-free ring
+//the third argument picks instrumentation, see queue_stats.h.
+struct mpmc {};
+struct mpsc {};
+struct spsc {};
+
+template<typename T, typename Policy = mpmc, typename Stats = no_queue_stats>
 class task_queue {
 public:
-    task_queue() {
+    //capacity 0 means unbounded, otherwise push blocks while the queue is full
+    explicit task_queue(size_t capacity = 0) : capacity(capacity), waiting(0), push_waiting(0), batch_waiting(0), closed(false) {
+#if TML_HAS_COROUTINES
+        co_head = co_tail = NULL;
+#endif
+    }
+    
+    //timeout in ms, <= 0 waits forever for room, same as pop.
+    //returns false on timeout or once the queue is closed, the caller keeps ownership of t
+    bool push(T *t, int timeout = 0) {
+        return push_one(t, true, timeout);
     }
     
-    bool push(T *t) {
+    //never blocks, returns false if the queue is full or closed
+    bool try_push(T *t) {
+        return push_one(t, false, 0);
+    }
+    
+    //push n tasks under a single lock acquisition,
+    //waking at most as many consumers as there are tasks.
+    //all or nothing: on a bounded queue it waits until all n fit,
+    //and fails at once if n exceeds the capacity
+    bool push_n(T **ts, size_t n, int timeout = 0) {
+        if (n == 0) {
+            return true;
+        }
         std::unique_lock<std::mutex> lock(mutex);
-        tasks.push(t);
-        cond.notify_one();
+        if (!wait_not_full(lock, n, true, timeout)) {
+            return false;
+        }
+        size_t i = 0;
+        while (i < n && resume_waiter(ts[i])) {
+            i++;
+        }
+        for (; i < n; i++) {
+            enqueue(ts[i]);
+        }
+        size_t wake = n < waiting ? n : waiting;
+        for (size_t i = 0; i < wake; i++) {
+            cond.notify_one();
+        }
         return true;
     }
     
+    //timeout in ms, <= 0 waits forever. NULL on timeout or once closed and drained
     T* pop(int timeout = 0) {
         std::unique_lock<std::mutex> lock(mutex);
+        if (!wait_not_empty(lock, timeout)) {
+            return NULL;
+        }
+        T *t = dequeue();
+        notify_not_full(1);
+        return t;
+    }
+    
+    //non-blocking pop, returns NULL when empty
+    T* try_pop() {
+        std::unique_lock<std::mutex> lock(mutex);
+        if (tasks.empty()) {
+            return NULL;
+        }
+        T *t = dequeue();
+        notify_not_full(1);
+        return t;
+    }
+    
+    //block like pop, then drain up to max tasks into out under the same lock.
+    //returns the number of tasks written, 0 on timeout
+    size_t pop_n(T **out, size_t max, int timeout = 0) {
+        if (max == 0) {
+            return 0;
+        }
+        std::unique_lock<std::mutex> lock(mutex);
+        if (!wait_not_empty(lock, timeout)) {
+            return 0;
+        }
+        size_t n = 0;
+        while (n < max && !tasks.empty()) {
+            out[n++] = dequeue();
+        }
+        notify_not_full(n);
+        return n;
+    }
+    
+    //block like pop, then append everything currently queued to out
+    size_t pop_all(std::vector<T *> &out, int timeout = 0) {
+        std::unique_lock<std::mutex> lock(mutex);
+        if (!wait_not_empty(lock, timeout)) {
+            return 0;
+        }
+        size_t n = tasks.size();
+        out.reserve(out.size() + n);
+        while (!tasks.empty()) {
+            out.push_back(dequeue());
+        }
+        notify_not_full(n);
+        return n;
+    }
+    
+    //stop accepting tasks and wake every waiter. blocked producers fail,
+    //consumers keep draining what is queued and get NULL once it is empty
+    void close() {
+        std::unique_lock<std::mutex> lock(mutex);
+        closed = true;
+        cond.notify_all();
+        not_full.notify_all();
+#if TML_HAS_COROUTINES
+        while (co_head) {
+            pop_awaiter *w = co_head;
+            co_head = w->next;
+            w->s->schedule(w->handle);
+        }
+        co_tail = NULL;
+#endif
+    }
+    
+    bool is_closed() {
+        std::unique_lock<std::mutex> lock(mutex);
+        return closed;
+    }
+    
+    size_t size() {
+        std::unique_lock<std::mutex> lock(mutex);
+        return tasks.size();
+    }
+    
+    //instrumentation, e.g. queue.stats().snap() with queue_stats
+    Stats &stats() {
+        return counters;
+    }
+    
+#if TML_HAS_COROUTINES
+    //T *t = co_await queue.async_pop(sched);
+    //suspends the coroutine instead of blocking the thread, and resumes it on sched
+    //once a task is handed over, or with NULL once the queue is closed and drained.
+    //coroutine waiters are served before blocked threads
+    class pop_awaiter {
+    public:
+        pop_awaiter(task_queue *q, coro::scheduler *s) : q(q), s(s), result(NULL), next(NULL) {
+        }
+        
+        bool await_ready() {
+            result = q->try_pop();
+            return result != NULL;
+        }
+        
+        bool await_suspend(std::coroutine_handle<> h) {
+            std::unique_lock<std::mutex> lock(q->mutex);
+            if (!q->tasks.empty()) {
+                result = q->dequeue();
+                q->notify_not_full(1);
+                return false;
+            }
+            if (q->closed) {
+                return false;
+            }
+            handle = h;
+            if (q->co_tail) {
+                q->co_tail->next = this;
+            } else {
+                q->co_head = this;
+            }
+            q->co_tail = this;
+            return true;
+        }
+        
+        T* await_resume() {
+            return result;
+        }
+        
+    private:
+        friend class task_queue;
+        task_queue *q;
+        coro::scheduler *s;
+        T *result;
+        pop_awaiter *next;
+        std::coroutine_handle<> handle;
+    };
+    
+    pop_awaiter async_pop(coro::scheduler &sched) {
+        return pop_awaiter(this, &sched);
+    }
+#endif
+    
+private:
+#if TML_HAS_COROUTINES
+    //caller holds the lock. hands t straight to the oldest suspended coroutine, if any
+    bool resume_waiter(T *t) {
+        pop_awaiter *w = co_head;
+        if (!w) {
+            return false;
+        }
+        co_head = w->next;
+        if (!co_head) {
+            co_tail = NULL;
+        }
+        counters.on_push(1);
+        counters.on_pop(Stats::now());
+        w->result = t;
+        w->s->schedule(w->handle);
+        return true;
+    }
+#else
+    bool resume_waiter(T *) {
+        return false;
+    }
+#endif
+    
+    struct entry : Stats::stamp {
+        T *task;
+    };
+    
+    //caller holds the lock
+    void enqueue(T *t) {
+        entry e;
+        static_cast<typename Stats::stamp &>(e) = Stats::now();
+        e.task = t;
+        counters.on_push(1);
+        tasks.push(e);
+    }
+    
+    //caller holds the lock and tasks is not empty
+    T* dequeue() {
+        const entry &e = tasks.front();
+        T *t = e.task;
+        counters.on_pop(e);
+        tasks.pop();
+        return t;
+    }
+    
+    bool push_one(T *t, bool wait, int timeout) {
+        std::unique_lock<std::mutex> lock(mutex);
+        if (!wait_not_full(lock, 1, wait, timeout)) {
+            return false;
+        }
+        if (resume_waiter(t)) {
+            return true;
+        }
+        enqueue(t);
+        cond.notify_one();
+        return true;
+    }
+    
+    //caller holds the lock. without wait it only checks for room,
+    //otherwise timeout in ms, <= 0 waits forever
+    bool wait_not_full(std::unique_lock<std::mutex> &lock, size_t n, bool wait, int timeout) {
+        if (closed || (capacity && n > capacity)) {
+            return false;
+        }
+        if (!capacity || tasks.size() + n <= capacity) {
+            return true;
+        }
+        if (!wait) {
+            return false;
+        }
+        auto deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(timeout);
+        push_waiting++;
+        if (n > 1) {
+            batch_waiting++;
+        }
+        while (!closed && tasks.size() + n > capacity) {
+            if (timeout > 0) {
+                if (std::cv_status::timeout == not_full.wait_until(lock, deadline)) {
+                    break;
+                }
+            } else {
+                not_full.wait(lock);
+            }
+        }
+        push_waiting--;
+        if (n > 1) {
+            batch_waiting--;
+        }
+        return !closed && tasks.size() + n <= capacity;
+    }
+    
+    //caller holds the lock, n slots were just freed
+    void notify_not_full(size_t n) {
+        if (!capacity || !push_waiting || !n) {
+            return;
+        }
+        //a woken batch producer may still not fit, so never rely on a single wakeup then
+        if (n > 1 || batch_waiting) {
+            not_full.notify_all();
+        } else {
+            not_full.notify_one();
+        }
+    }
+    
+    //caller holds the lock. timeout in ms, <= 0 waits forever.
+    //returns false on timeout, or when the queue is closed and drained
+    bool wait_not_empty(std::unique_lock<std::mutex> &lock, int timeout) {
         if (!tasks.empty()) {
-            T *t = tasks.front();
-            tasks.pop();
-            return t;
+            return true;
         }
-        while (tasks.empty()) {
+        if (closed) {
+            return false;
+        }
+        typename Stats::stamp start = Stats::now();
+        auto deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(timeout);
+        waiting++;
+        while (tasks.empty() && !closed) {
             if (timeout > 0) {
-                if (std::cv_status::timeout == cond.wait_for(lock, std::chrono::milliseconds(timeout))) {
-                    return NULL;
+                if (std::cv_status::timeout == cond.wait_until(lock, deadline)) {
+                    break;
                 }
             } else {
                 cond.wait(lock);
             }
         }
-        T *t = tasks.front();
-        tasks.pop();
-        return t;
+        waiting--;
+        counters.on_wait(start);
+        return !tasks.empty();
     }
     
-private:
-    std::queue<T *> tasks;
+    std::queue<entry> tasks;
+    const size_t capacity;
+    size_t waiting;
+    size_t push_waiting;
+    size_t batch_waiting;
+    bool closed;
+    Stats counters;
+#if TML_HAS_COROUTINES
+    pop_awaiter *co_head;
+    pop_awaiter *co_tail;
+#endif
     std::mutex mutex;
     std::condition_variable cond;
+    std::condition_variable not_full;
+};
+
+//single producer, single consumer: bounded ring where each side only
+//publishes its own index with a release store. push waits for room, try_push doesn't.
+//a blocked side spins and yields by default, so the hot path is acquire/release only.
+template<typename T, typename Stats>
+class task_queue<T, spsc, Stats> {
+public:
+    //capacity is rounded up to a power of two.
+    //park lets a blocked push or pop sleep instead of yielding in a loop, which costs
+    //every push and pop a seq_cst fence to check for sleepers (about 10 ns each uncontended)
+    explicit task_queue(size_t capacity = 1024, bool park = false) : ring(round_up(capacity)), mask(ring.size() - 1),
+        park(park), tail(0), cached_head(0), head(0), cached_tail(0), closed(false) {
+    }
+    
+    task_queue(const task_queue &) = delete;
+    task_queue &operator=(const task_queue &) = delete;
+    
+    //timeout in ms, <= 0 waits forever for room, same as pop.
+    //returns false on timeout or once the queue is closed, the caller keeps ownership of t
+    bool push(T *t, int timeout = 0) {
+        return push_ring(&t, 1, true, timeout);
+    }
+    
+    bool try_push(T *t) {
+        return push_ring(&t, 1, false, 0);
+    }
+    
+    //all or nothing, returns false without pushing anything if n tasks don't fit in time
+    bool push_n(T **ts, size_t n, int timeout = 0) {
+        return push_ring(ts, n, true, timeout);
+    }
+    
+    T* try_pop() {
+        T *t = NULL;
+        try_pop_n(&t, 1);
+        return t;
+    }
+    
+    //timeout in ms, <= 0 waits forever. NULL on timeout or once closed and drained
+    T* pop(int timeout = 0) {
+        T *t = NULL;
+        pop_n(&t, 1, timeout);
+        return t;
+    }
+    
+    size_t pop_n(T **out, size_t max, int timeout = 0) {
+        size_t n = 0;
+        if (max == 0 || (n = try_pop_n(out, max)) != 0) {
+            return n;
+        }
+        typename Stats::stamp start = Stats::now();
+        block(not_empty, [&]() {
+            if ((n = try_pop_n(out, max)) != 0) {
+                return true;
+            }
+            //everything pushed before close() is visible once closed is, drain it first
+            if (closed.load(std::memory_order_acquire)) {
+                n = try_pop_n(out, max);
+                return true;
+            }
+            return false;
+        }, timeout);
+        counters.on_wait(start);
+        return n;
+    }
+    
+    size_t pop_all(std::vector<T *> &out, int timeout = 0) {
+        size_t old = out.size();
+        out.resize(old + ring.size());
+        size_t n = pop_n(&out[old], ring.size(), timeout);
+        out.resize(old + n);
+        return n;
+    }
+    
+    //producer must not push after this, pop drains what is left and then returns NULL
+    void close() {
+        closed.store(true, std::memory_order_release);
+        not_empty.notify_all();
+        not_full.notify_all();
+    }
+    
+    bool is_closed() {
+        return closed.load(std::memory_order_acquire);
+    }
+    
+    size_t size() {
+        return tail.load(std::memory_order_acquire) - head.load(std::memory_order_acquire);
+    }
+    
+    Stats &stats() {
+        return counters;
+    }
+    
+private:
+    struct entry : Stats::stamp {
+        T *task;
+    };
+    
+    //producer side. without wait it only checks for room
+    bool push_ring(T **ts, size_t n, bool wait, int timeout) {
+        if (n > ring.size() || closed.load(std::memory_order_relaxed)) {
+            return false;
+        }
+        size_t pos = tail.load(std::memory_order_relaxed);
+        if (!reserve(pos, n)) {
+            if (!wait) {
+                return false;
+            }
+            block(not_full, [&]() { return reserve(pos, n) || closed.load(std::memory_order_relaxed); }, timeout);
+            if (!reserve(pos, n) || closed.load(std::memory_order_relaxed)) {
+                return false;
+            }
+        }
+        counters.on_push(n);
+        for (size_t i = 0; i < n; i++) {
+            put(pos + i, ts[i]);
+        }
+        tail.store(pos + n, std::memory_order_release);
+        wake(not_empty);
+        return true;
+    }
+    
+    template<typename Pred>
+    bool block(event_count &ev, Pred ready, int timeout) {
+        return park ? ev.wait(ready, timeout) : spin_until(ready, timeout);
+    }
+    
+    void wake(event_count &ev) {
+        if (park) {
+            ev.notify_one();
+        }
+    }
+    
+    void put(size_t pos, T *t) {
+        entry &e = ring[pos & mask];
+        static_cast<typename Stats::stamp &>(e) = Stats::now();
+        e.task = t;
+    }
+    
+    static const size_t CACHE_LINE = 64;
+    
+    static size_t round_up(size_t n) {
+        size_t r = 2;
+        while (r < n) {
+            r <<= 1;
+        }
+        return r;
+    }
+    
+    //producer side, true if n more slots are free after pos
+    bool reserve(size_t pos, size_t n) {
+        if (pos + n - cached_head <= ring.size()) {
+            return true;
+        }
+        cached_head = head.load(std::memory_order_acquire);
+        return pos + n - cached_head <= ring.size();
+    }
+    
+    //consumer side
+    size_t try_pop_n(T **out, size_t max) {
+        size_t pos = head.load(std::memory_order_relaxed);
+        if (pos == cached_tail) {
+            cached_tail = tail.load(std::memory_order_acquire);
+            if (pos == cached_tail) {
+                return 0;
+            }
+        }
+        size_t n = cached_tail - pos;
+        if (n > max) {
+            n = max;
+        }
+        for (size_t i = 0; i < n; i++) {
+            const entry &e = ring[(pos + i) & mask];
+            out[i] = e.task;
+            counters.on_pop(e);
+        }
+        head.store(pos + n, std::memory_order_release);
+        wake(not_full);
+        return n;
+    }
+    
+    std::vector<entry> ring;
+    const size_t mask;
+    const bool park;
+    //each side keeps a stale copy of the other's index and only rereads it when it looks full/empty
+    alignas(CACHE_LINE) std::atomic<size_t> tail;
+    size_t cached_head;
+    alignas(CACHE_LINE) std::atomic<size_t> head;
+    size_t cached_tail;
+    alignas(CACHE_LINE) event_count not_empty;
+    alignas(CACHE_LINE) event_count not_full;
+    std::atomic<bool> closed;
+    Stats counters;
+};
+
+//many producers, single consumer: Vyukov linked-list queue.
+//push is one atomic exchange and never blocks or fails, pop needs no CAS at all.
+template<typename T, typename Stats>
+class task_queue<T, mpsc, Stats> {
+public:
+    task_queue() : stub(), head(&stub), tail(&stub), count(0), closed(false) {
+    }
+    
+    task_queue(const task_queue &) = delete;
+    task_queue &operator=(const task_queue &) = delete;
+    
+    ~task_queue() {
+        while (try_pop()) {
+        }
+        if (tail != &stub) {
+            delete tail;
+        }
+    }
+    
+    //timeout in ms, <= 0 waits forever for room, same as pop.
+    //unbounded, so there is always room and it only fails once the queue is closed
+    bool push(T *t, int = 0) {
+        if (closed.load(std::memory_order_relaxed)) {
+            return false;
+        }
+        counters.on_push(1);
+        count.fetch_add(1, std::memory_order_relaxed);
+        enqueue(new node(t));
+        not_empty.notify_one();
+        return true;
+    }
+    
+    bool try_push(T *t) {
+        return push(t);
+    }
+    
+    bool push_n(T **ts, size_t n, int = 0) {
+        if (closed.load(std::memory_order_relaxed)) {
+            return false;
+        }
+        if (n == 0) {
+            return true;
+        }
+        counters.on_push(n);
+        count.fetch_add(n, std::memory_order_relaxed);
+        //link the batch privately, then publish it with a single exchange
+        node *first = new node(ts[0]);
+        node *last = first;
+        for (size_t i = 1; i < n; i++) {
+            node *nd = new node(ts[i]);
+            last->next.store(nd, std::memory_order_relaxed);
+            last = nd;
+        }
+        node *prev = head.exchange(last, std::memory_order_acq_rel);
+        prev->next.store(first, std::memory_order_release);
+        not_empty.notify_one();
+        return true;
+    }
+    
+    T* try_pop() {
+        node *next = tail->next.load(std::memory_order_acquire);
+        if (!next) {
+            return NULL;
+        }
+        T *t = next->task;
+        count.fetch_sub(1, std::memory_order_relaxed);
+        counters.on_pop(*next);
+        if (tail != &stub) {
+            delete tail;
+        }
+        tail = next;
+        return t;
+    }
+    
+    //timeout in ms, <= 0 waits forever. NULL on timeout or once closed and drained
+    T* pop(int timeout = 0) {
+        T *t = try_pop();
+        if (!t) {
+            typename Stats::stamp start = Stats::now();
+            not_empty.wait([&]() {
+                if ((t = try_pop()) != NULL) {
+                    return true;
+                }
+                if (closed.load(std::memory_order_acquire)) {
+                    //a producer may have swapped head but not linked it yet
+                    while ((t = try_pop()) == NULL && head.load(std::memory_order_acquire) != tail) {
+                        cpu_relax();
+                    }
+                    return true;
+                }
+                return false;
+            }, timeout);
+            counters.on_wait(start);
+        }
+        return t;
+    }
+    
+    size_t pop_n(T **out, size_t max, int timeout = 0) {
+        if (max == 0 || !(out[0] = pop(timeout))) {
+            return 0;
+        }
+        size_t n = 1;
+        while (n < max && (out[n] = try_pop())) {
+            n++;
+        }
+        return n;
+    }
+    
+    size_t pop_all(std::vector<T *> &out, int timeout = 0) {
+        T *t = pop(timeout);
+        if (!t) {
+            return 0;
+        }
+        size_t n = 0;
+        do {
+            out.push_back(t);
+            n++;
+        } while ((t = try_pop()));
+        return n;
+    }
+    
+    //producers must not push after this, pop drains what is left and then returns NULL
+    void close() {
+        closed.store(true, std::memory_order_release);
+        not_empty.notify_all();
+    }
+    
+    bool is_closed() {
+        return closed.load(std::memory_order_acquire);
+    }
+    
+    //approximate while producers are pushing
+    size_t size() {
+        long n = count.load(std::memory_order_relaxed);
+        return n > 0 ? (size_t)n : 0;
+    }
+    
+    Stats &stats() {
+        return counters;
+    }
+    
+private:
+    struct node : Stats::stamp {
+        explicit node(T *t = NULL) : Stats::stamp(Stats::now()), task(t), next(NULL) {
+        }
+        T *task;
+        std::atomic<node *> next;
+    };
+    
+    void enqueue(node *nd) {
+        node *prev = head.exchange(nd, std::memory_order_acq_rel);
+        prev->next.store(nd, std::memory_order_release);
+    }
+    
+    static const size_t CACHE_LINE = 64;
+    
+    node stub;
+    //head is where producers append, tail is the consumer's last popped node
+    alignas(CACHE_LINE) std::atomic<node *> head;
+    alignas(CACHE_LINE) node *tail;
+    alignas(CACHE_LINE) event_count not_empty;
+    std::atomic<long> count;
+    std::atomic<bool> closed;
+    Stats counters;
 };
 
 }
@@ -38,12 +38,12 @@ private:
 
 void ThreadFunc(common::connection_pool<connection> *pool) {
     while (true) {
-        connection *conn = pool->get();
+        auto conn = pool->get();
         if (conn) {
             if (!conn->test()) {
-                pool->mark_invalid(conn);
+                conn.mark_invalid();
             } else {
-                pool->put_back(conn);
+                conn.release();
             }
         }
         std::this_thread::sleep_for(std::chrono::milliseconds(rand() % 100));
@@ -0,0 +1,157 @@
+#include "AsyncCurl.h"
+#include "bench/mock_http_server.h"
+#include <iostream>
+#include <vector>
+
+const int REQUESTS = 40;
+
+//how often each request's callback ran and with what
+struct Outcome {
+    std::atomic<int> calls;
+    std::atomic<int> code;
+    std::atomic<long> status;
+
+    Outcome() : calls(0), code(-1), status(0) {
+    }
+};
+
+uint64_t submit(AsyncCurl &client, const std::string &url, Outcome &out) {
+    AsyncRequest req;
+    req.url = url;
+    return client.Submit(req, [&out](AsyncResponse &resp) {
+        out.code = resp.code;
+        out.status = resp.status;
+        out.calls++;
+    });
+}
+
+bool wait_idle(AsyncCurl &client) {
+    for (int i = 0; i < 500 && client.Pending() != 0; i++) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    }
+    return client.Pending() == 0;
+}
+
+//cancelled requests, in flight or still queued behind maxInFlight, complete once
+//with CURLE_ABORTED_BY_CALLBACK and the rest are answered normally
+bool test_cancel(const std::string &url) {
+    std::vector<Outcome> outcomes(REQUESTS);
+    std::vector<uint64_t> ids;
+    AsyncCurl client(8);
+    client.Start();
+    for (int i = 0; i < REQUESTS; i++) {
+        ids.push_back(submit(client, url, outcomes[i]));
+    }
+    for (int i = 1; i < REQUESTS; i += 2) {
+        client.Cancel(ids[i]);
+    }
+    //twice, and an id that was never handed out
+    client.Cancel(ids[1]);
+    client.Cancel(ids.back() + 1000);
+    bool ok = wait_idle(client);
+    //completed ids are ignored
+    for (int i = 0; i < REQUESTS; i++) {
+        client.Cancel(ids[i]);
+    }
+    std::this_thread::sleep_for(std::chrono::milliseconds(20));
+    client.Stop();
+
+    int once = 0, aborted = 0, answered = 0;
+    for (int i = 0; i < REQUESTS; i++) {
+        once += outcomes[i].calls == 1;
+        if (i % 2) {
+            aborted += outcomes[i].code == CURLE_ABORTED_BY_CALLBACK;
+        } else {
+            answered += outcomes[i].code == CURLE_OK && outcomes[i].status == 200;
+        }
+    }
+    std::cout << "cancel: once " << once << ", aborted " << aborted << ", answered " << answered << std::endl;
+    return ok && once == REQUESTS && aborted == REQUESTS / 2 && answered == REQUESTS / 2;
+}
+
+//Stop fails everything still pending exactly once, callbacks and futures alike,
+//and nothing is accepted afterwards
+bool test_stop(const std::string &url) {
+    std::vector<Outcome> outcomes(REQUESTS);
+    AsyncCurl client(8);
+    client.Start();
+    for (int i = 0; i < REQUESTS; i++) {
+        submit(client, url, outcomes[i]);
+    }
+    AsyncRequest req;
+    req.url = url;
+    std::future<AsyncResponse> future = client.Submit(req);
+    std::atomic<int> timers(0);
+    client.Schedule(60000, [&]() { timers++; });
+    std::this_thread::sleep_for(std::chrono::milliseconds(20));
+    client.Stop();
+
+    bool ok = future.wait_for(std::chrono::seconds(0)) == std::future_status::ready
+        && future.get().code == CURLE_ABORTED_BY_CALLBACK;
+    Outcome late;
+    ok = ok && submit(client, url, late) == 0 && !client.Schedule(0, [&]() { timers++; });
+    //a second Stop must not run anything again
+    client.Stop();
+    std::this_thread::sleep_for(std::chrono::milliseconds(20));
+    int once = 0, aborted = 0;
+    for (int i = 0; i < REQUESTS; i++) {
+        once += outcomes[i].calls == 1;
+        aborted += outcomes[i].code == CURLE_ABORTED_BY_CALLBACK;
+    }
+    std::cout << "stop: aborted " << aborted << ", timers " << timers << ", pending " << client.Pending() << std::endl;
+    return ok && once == REQUESTS && aborted == REQUESTS && timers == 1 && late.calls == 0 && client.Pending() == 0;
+}
+
+//Stop from a callback only starts the shutdown, the rest still fail once and the
+//owner's Stop joins the loop. several threads may call Stop at the same time
+bool test_stop_inside(const std::string &url) {
+    std::vector<Outcome> outcomes(REQUESTS);
+    AsyncCurl client(8);
+    client.Start();
+    AsyncRequest req;
+    req.url = url;
+    std::atomic<int> first(0);
+    //the mock server delays every request, so any completion comes first: a cancel
+    uint64_t id = client.Submit(req, [&](AsyncResponse &) {
+        client.Stop();
+        first++;
+    });
+    for (int i = 0; i < REQUESTS; i++) {
+        submit(client, url, outcomes[i]);
+    }
+    client.Cancel(id);
+    for (int i = 0; i < 200 && client.Pending() != 0; i++) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(5));
+    }
+    bool restarted = client.Start();
+    std::vector<std::thread> stoppers;
+    for (int i = 0; i < 4; i++) {
+        stoppers.push_back(std::thread([&]() { client.Stop(); }));
+    }
+    for (size_t i = 0; i < stoppers.size(); i++) {
+        stoppers[i].join();
+    }
+    int once = 0;
+    for (int i = 0; i < REQUESTS; i++) {
+        once += outcomes[i].calls == 1 && outcomes[i].code == CURLE_ABORTED_BY_CALLBACK;
+    }
+    std::cout << "stop inside: first " << first << ", aborted once " << once << ", restarted " << restarted << std::endl;
+    return first == 1 && once == REQUESTS && !restarted && client.Pending() == 0 && client.Start();
+}
+
+int main(int argc, char *argv[]) {
+    bench::mock_options opt;
+    opt.latency_us = 300 * 1000;
+    bench::mock_http_server server(opt);
+    if (!server.start()) {
+        std::cout << "FAILED to start server" << std::endl;
+        return 1;
+    }
+    const std::string url = server.url("/");
+    bool ok = test_cancel(url);
+    ok = test_stop(url) && ok;
+    ok = test_stop_inside(url) && ok;
+    server.stop();
+    std::cout << (ok ? "OK" : "FAILED") << std::endl;
+    return ok ? 0 : 1;
+}
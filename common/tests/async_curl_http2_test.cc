@@ -0,0 +1,41 @@
+//checks that HTTP2_PRIOR_KNOWLEDGE multiplexes concurrent requests onto one connection.
+//needs an h2c server, e.g.
+//    nghttpd --no-tls 18082 -d /tmp/h2root & echo hi > /tmp/h2root/x
+//    ./async_curl_http2_test http://127.0.0.1:18082/x
+//and prints SKIPPED without a url or when libcurl was built without HTTP/2
+#include "AsyncCurl.h"
+#include <iostream>
+#include <vector>
+
+int main(int argc, char *argv[]) {
+    curl_version_info_data *info = curl_version_info(CURLVERSION_NOW);
+    if (argc < 2 || !(info->features & CURL_VERSION_HTTP2)) {
+        std::cout << "SKIPPED" << std::endl;
+        return 0;
+    }
+    const int REQUESTS = 100;
+    AsyncCurl client(REQUESTS);
+    client.SetHttp2(HTTP2_PRIOR_KNOWLEDGE, 100, 1);
+    client.Start();
+
+    std::vector<std::future<AsyncResponse> > responses;
+    for (int i = 0; i < REQUESTS; i++) {
+        AsyncRequest req;
+        req.url = argv[1];
+        responses.push_back(client.Submit(req));
+    }
+    int ok = 0, h2 = 0;
+    long connects = 0;
+    for (size_t i = 0; i < responses.size(); i++) {
+        AsyncResponse resp = responses[i].get();
+        ok += resp.Ok() && resp.status == 200;
+        h2 += resp.httpVersion == CURL_HTTP_VERSION_2_0;
+        connects += resp.connects;
+    }
+    client.Stop();
+
+    std::cout << "ok: " << ok << ", http/2: " << h2 << ", connections opened: " << connects << std::endl;
+    bool passed = ok == REQUESTS && h2 == REQUESTS && connects == 1;
+    std::cout << (passed ? "OK" : "FAILED") << std::endl;
+    return passed ? 0 : 1;
+}
@@ -0,0 +1,101 @@
+#pragma once
+
+#ifndef __TML_BENCH_UTIL_INC__
+#define __TML_BENCH_UTIL_INC__
+
+#include <chrono>
+#include <cstdio>
+#include <cstdint>
+#include <cstring>
+#include <cstdlib>
+#include <string>
+
+#include "histogram.h"
+
+namespace bench {
+
+inline uint64_t now_ns() {
+    return (uint64_t)std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+struct options {
+    uint64_t ops;           //operations per configuration
+    int duration_ms;        //for time-bounded benchmarks
+    bool csv;               //csv instead of json lines
+    std::string filter;     //only run configurations whose name contains this
+
+    options() : ops(200000), duration_ms(1000), csv(false) {
+    }
+
+    //--ops N --duration MS --format json|csv --filter NAME
+    bool parse(int argc, char *argv[]) {
+        for (int i = 1; i < argc; i++) {
+            bool has_value = i + 1 < argc;
+            if (!strcmp(argv[i], "--ops") && has_value) {
+                ops = strtoull(argv[++i], NULL, 10);
+            } else if (!strcmp(argv[i], "--duration") && has_value) {
+                duration_ms = atoi(argv[++i]);
+            } else if (!strcmp(argv[i], "--format") && has_value) {
+                csv = !strcmp(argv[++i], "csv");
+            } else if (!strcmp(argv[i], "--filter") && has_value) {
+                filter = argv[++i];
+            } else {
+                fprintf(stderr, "usage: %s [--ops N] [--duration MS] [--format json|csv] [--filter NAME]\n", argv[0]);
+                return false;
+            }
+        }
+        return true;
+    }
+
+    bool selected(const std::string &name) const {
+        return filter.empty() || name.find(filter) != std::string::npos;
+    }
+};
+
+//one result line, machine readable so runs can be diffed for regressions
+struct result {
+    std::string bench;
+    std::string variant;
+    int producers;
+    int consumers;
+    int payload;
+    uint64_t ops;
+    uint64_t elapsed_ns;
+    common::histogram::snapshot latency_ns;
+
+    result() : producers(0), consumers(0), payload(0), ops(0), elapsed_ns(0) {
+    }
+
+    void print(const options &opt) const {
+        static bool header = false;
+        double ops_per_sec = elapsed_ns ? ops * 1e9 / elapsed_ns : 0.0;
+        if (opt.csv) {
+            if (!header) {
+                printf("bench,variant,producers,consumers,payload,ops,ops_per_sec,p50_ns,p99_ns,p999_ns,max_ns\n");
+                header = true;
+            }
+            printf("%s,%s,%d,%d,%d,%llu,%.0f,%llu,%llu,%llu,%llu\n",
+                bench.c_str(), variant.c_str(), producers, consumers, payload,
+                (unsigned long long)ops, ops_per_sec,
+                (unsigned long long)latency_ns.percentile(0.50),
+                (unsigned long long)latency_ns.percentile(0.99),
+                (unsigned long long)latency_ns.percentile(0.999),
+                (unsigned long long)latency_ns.max);
+        } else {
+            printf("{\"bench\":\"%s\",\"variant\":\"%s\",\"producers\":%d,\"consumers\":%d,\"payload\":%d,"
+                "\"ops\":%llu,\"ops_per_sec\":%.0f,\"p50_ns\":%llu,\"p99_ns\":%llu,\"p999_ns\":%llu,\"max_ns\":%llu}\n",
+                bench.c_str(), variant.c_str(), producers, consumers, payload,
+                (unsigned long long)ops, ops_per_sec,
+                (unsigned long long)latency_ns.percentile(0.50),
+                (unsigned long long)latency_ns.percentile(0.99),
+                (unsigned long long)latency_ns.percentile(0.999),
+                (unsigned long long)latency_ns.max);
+        }
+        fflush(stdout);
+    }
+};
+
+}
+
+#endif //__TML_BENCH_UTIL_INC__
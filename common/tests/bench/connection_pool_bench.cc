@@ -0,0 +1,114 @@
+//get/put_back throughput and get() latency of connection_pool under
+//increasing numbers of request threads competing for a fixed set of connections.
+//reported as producers = request threads, consumers = pooled connections.
+#include <atomic>
+#include <thread>
+#include <vector>
+#include <string>
+
+#include "bench_util.h"
+#include "ConnectionPool.h"
+#include "ShardedConnectionPool.h"
+
+class connection {
+public:
+    bool reconnect() {
+        return true;
+    }
+
+    void use() {
+        //stand-in for a short request on the connection
+        for (volatile int i = 0; i < 100; i++) {
+        }
+    }
+};
+
+//one get/use/return round, false on timeout. connection_pool hands out
+//a lease that returns itself, sharded_connection_pool a raw pointer
+bool round_trip(common::connection_pool<connection> &pool, common::histogram &latency) {
+    uint64_t t0 = bench::now_ns();
+    auto conn = pool.get(100);
+    if (!conn) {
+        return false;
+    }
+    latency.record(bench::now_ns() - t0);
+    conn->use();
+    return true;
+}
+
+bool round_trip(common::sharded_connection_pool<connection> &pool, common::histogram &latency) {
+    uint64_t t0 = bench::now_ns();
+    connection *conn = pool.get(100);
+    if (!conn) {
+        return false;
+    }
+    latency.record(bench::now_ns() - t0);
+    conn->use();
+    pool.put_back(conn);
+    return true;
+}
+
+template<typename Pool>
+bench::result run(Pool &pool, const std::string &variant, int threads, int connections, const bench::options &opt) {
+    std::vector<connection> conns(connections);
+    for (int i = 0; i < connections; i++) {
+        pool.add(&conns[i]);
+    }
+
+    std::atomic<bool> stop(false);
+    std::atomic<uint64_t> ops(0);
+    common::histogram latency;
+    std::vector<std::thread> workers;
+    uint64_t start = bench::now_ns();
+    for (int i = 0; i < threads; i++) {
+        workers.push_back(std::thread([&]() {
+            uint64_t n = 0;
+            while (!stop.load(std::memory_order_relaxed)) {
+                if (round_trip(pool, latency)) {
+                    n++;
+                }
+            }
+            ops += n;
+        }));
+    }
+    std::this_thread::sleep_for(std::chrono::milliseconds(opt.duration_ms));
+    stop = true;
+    for (size_t i = 0; i < workers.size(); i++) {
+        workers[i].join();
+    }
+
+    bench::result r;
+    r.bench = "connection_pool";
+    r.variant = variant;
+    r.producers = threads;
+    r.consumers = connections;
+    r.ops = ops;
+    r.elapsed_ns = bench::now_ns() - start;
+    r.latency_ns = latency.snap();
+    return r;
+}
+
+int main(int argc, char *argv[]) {
+    bench::options opt;
+    if (!opt.parse(argc, argv)) {
+        return 1;
+    }
+    const int thread_counts[] = { 1, 2, 4, 8, 16, 32, 64 };
+    const int CONNECTIONS = 8;
+    for (int t : thread_counts) {
+        if (opt.selected("connection_pool")) {
+            common::connection_pool<connection> pool(false);
+            run(pool, "connection_pool", t, CONNECTIONS, opt).print(opt);
+        }
+        if (opt.selected("fair")) {
+            common::connection_pool<connection> pool(false);
+            pool.set_fair(true);
+            run(pool, "fair", t, CONNECTIONS, opt).print(opt);
+        }
+        if (opt.selected("sharded")) {
+            common::sharded_connection_pool<connection> pool(4, false);
+            run(pool, "sharded", t, CONNECTIONS, opt).print(opt);
+        }
+    }
+    return 0;
+}
@@ -0,0 +1,267 @@
+//load generator for the Curl client against the loopback mock_http_server: blocking
+//Curl::Post per thread, handles leased from a CurlContext pool, and AsyncCurl.
+//without --rps every worker sends as soon as its last response is back (max throughput),
+//with --rps requests are due on a fixed schedule and latency runs from when a request was
+//due, not when it went out, so a client that falls behind shows up in the percentiles
+//instead of quietly sending less.
+//reported as producers = concurrent requests, consumers = server threads, payload = response bytes.
+#include <atomic>
+#include <thread>
+#include <vector>
+#include <string>
+#include <future>
+
+#include "bench_util.h"
+#include "mock_http_server.h"
+#include "Curl.h"
+#include "CurlContext.h"
+#include "AsyncCurl.h"
+
+struct load_options {
+    uint64_t rps;                   //0 = as fast as possible
+    std::vector<int> concurrency;
+    size_t request_bytes;
+    bench::mock_options server;
+
+    load_options() : rps(0), request_bytes(256) {
+        concurrency = { 1, 8, 64 };
+    }
+
+    //takes its own flags out of argv, the rest is left for bench::options
+    bool parse(int &argc, char *argv[]) {
+        int kept = 1;
+        for (int i = 1; i < argc; i++) {
+            bool has_value = i + 1 < argc;
+            if (!strcmp(argv[i], "--rps") && has_value) {
+                rps = strtoull(argv[++i], NULL, 10);
+            } else if (!strcmp(argv[i], "--concurrency") && has_value) {
+                concurrency.clear();
+                for (char *p = argv[++i]; *p; ) {
+                    int c = (int)strtol(p, &p, 10);
+                    if (c > 0) {
+                        concurrency.push_back(c);
+                    }
+                    if (*p == ',') {
+                        p++;
+                    } else if (*p) {
+                        return usage(argv[0]);
+                    }
+                }
+            } else if (!strcmp(argv[i], "--request-bytes") && has_value) {
+                request_bytes = strtoull(argv[++i], NULL, 10);
+            } else if (!strcmp(argv[i], "--response-bytes") && has_value) {
+                server.response_bytes = strtoull(argv[++i], NULL, 10);
+            } else if (!strcmp(argv[i], "--latency-us") && has_value) {
+                server.latency_us = strtoull(argv[++i], NULL, 10);
+            } else if (!strcmp(argv[i], "--dist") && has_value) {
+                const char *d = argv[++i];
+                if (!strcmp(d, "fixed")) {
+                    server.dist = bench::LATENCY_FIXED;
+                } else if (!strcmp(d, "uniform")) {
+                    server.dist = bench::LATENCY_UNIFORM;
+                } else if (!strcmp(d, "exp")) {
+                    server.dist = bench::LATENCY_EXPONENTIAL;
+                } else {
+                    return usage(argv[0]);
+                }
+            } else if (!strcmp(argv[i], "--tail-ratio") && has_value) {
+                server.tail_ratio = atof(argv[++i]);
+            } else if (!strcmp(argv[i], "--tail-us") && has_value) {
+                server.tail_us = strtoull(argv[++i], NULL, 10);
+            } else if (!strcmp(argv[i], "--error-rate") && has_value) {
+                server.error_rate = atof(argv[++i]);
+            } else if (!strcmp(argv[i], "--server-threads") && has_value) {
+                server.threads = atoi(argv[++i]);
+            } else {
+                argv[kept++] = argv[i];
+            }
+        }
+        argc = kept;
+        return !concurrency.empty() || usage(argv[0]);
+    }
+
+    static bool usage(const char *name) {
+        fprintf(stderr, "usage: %s [--rps N] [--concurrency 1,8,64] [--request-bytes N] [--response-bytes N]\n"
+            "    [--latency-us N] [--dist fixed|uniform|exp] [--tail-ratio F] [--tail-us N] [--error-rate F]\n"
+            "    [--server-threads N] [--duration MS] [--format json|csv] [--filter NAME]\n", name);
+        return false;
+    }
+};
+
+struct tally {
+    std::atomic<uint64_t> ok;
+    std::atomic<uint64_t> errors;
+    common::histogram latency;
+
+    tally() : ok(0), errors(0) {
+    }
+
+    void record(uint64_t since, bool success) {
+        latency.record(bench::now_ns() - since);
+        (success ? ok : errors).fetch_add(1, std::memory_order_relaxed);
+    }
+};
+
+//one blocking worker out of concurrency. post sends a request and returns the http status.
+//at a fixed rate worker i owns every concurrency-th slot of the schedule, starting at slot i
+template<typename Post>
+void drive(Post post, int index, int concurrency, const load_options &load, uint64_t start, uint64_t end, tally &t) {
+    std::string body(load.request_bytes, 'r');
+    std::string out;
+    uint64_t interval = load.rps ? (uint64_t)(1e9 * concurrency / load.rps) : 0;
+    uint64_t due = start + (load.rps ? (uint64_t)(1e9 * index / load.rps) : 0);
+    while (true) {
+        uint64_t now = bench::now_ns();
+        if (load.rps) {
+            if (due >= end) {
+                break;
+            }
+            if (due > now) {
+                std::this_thread::sleep_for(std::chrono::nanoseconds(due - now));
+            }
+        } else if (now >= end) {
+            break;
+        }
+        uint64_t since = load.rps ? due : bench::now_ns();
+        out.clear();
+        t.record(since, post(body, out) == 200);
+        due += interval;
+    }
+}
+
+template<typename MakePost>
+void run_blocking(MakePost make_post, int concurrency, const load_options &load, const bench::options &opt, tally &t) {
+    std::vector<std::thread> threads;
+    uint64_t start = bench::now_ns();
+    uint64_t end = start + (uint64_t)opt.duration_ms * 1000000;
+    for (int i = 0; i < concurrency; i++) {
+        threads.push_back(std::thread([&, i]() {
+            drive(make_post(), i, concurrency, load, start, end, t);
+        }));
+    }
+    for (size_t i = 0; i < threads.size(); i++) {
+        threads[i].join();
+    }
+}
+
+//max throughput keeps concurrency requests in flight, each completion sends the next.
+//at a fixed rate this thread submits on schedule and AsyncCurl queues what doesn't fit
+void run_async(const std::string &url, int concurrency, const load_options &load, const bench::options &opt, tally &t) {
+    AsyncCurl client((size_t)concurrency);
+    client.Start();
+    std::string body(load.request_bytes, 'r');
+    uint64_t start = bench::now_ns();
+    uint64_t end = start + (uint64_t)opt.duration_ms * 1000000;
+    //client.Pending() drops before the callback that may send the next request has run
+    std::atomic<uint64_t> outstanding(0);
+    std::function<void(uint64_t)> send = [&](uint64_t since) {
+        AsyncRequest req;
+        req.url = url;
+        req.body = body;
+        outstanding++;
+        uint64_t id = client.Submit(std::move(req), [&, since](AsyncResponse &resp) {
+            t.record(since, resp.Ok() && resp.status == 200);
+            uint64_t now = bench::now_ns();
+            if (!load.rps && now < end) {
+                send(now);
+            }
+            outstanding--;
+        });
+        if (id == 0) {
+            outstanding--;
+        }
+    };
+    if (load.rps) {
+        for (uint64_t k = 0; ; k++) {
+            uint64_t due = start + (uint64_t)(1e9 * k / load.rps);
+            if (due >= end) {
+                break;
+            }
+            uint64_t now = bench::now_ns();
+            if (due > now) {
+                std::this_thread::sleep_for(std::chrono::nanoseconds(due - now));
+            }
+            send(due);
+        }
+    } else {
+        for (int i = 0; i < concurrency; i++) {
+            send(bench::now_ns());
+        }
+        std::this_thread::sleep_for(std::chrono::milliseconds(opt.duration_ms));
+    }
+    while (outstanding.load() > 0) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+    client.Stop();
+}
+
+int main(int argc, char *argv[]) {
+    load_options load;
+    bench::options opt;
+    if (!load.parse(argc, argv)) {
+        return 1;
+    }
+    if (!opt.parse(argc, argv)) {
+        load_options::usage(argv[0]);
+        return 1;
+    }
+    bench::mock_http_server server(load.server);
+    if (!server.start()) {
+        fprintf(stderr, "mock server failed to start\n");
+        return 1;
+    }
+    CurlContext::GlobalInit();
+    const std::string url = server.url("/load");
+    const char *modes[] = { "curl", "pooled", "async" };
+    for (int c : load.concurrency) {
+        for (const char *mode : modes) {
+            std::string variant = mode;
+            if (load.rps) {
+                variant += "_" + std::to_string(load.rps) + "rps";
+            }
+            if (!opt.selected(variant)) {
+                continue;
+            }
+            tally t;
+            uint64_t start = bench::now_ns();
+            if (!strcmp(mode, "curl")) {
+                run_blocking([&]() {
+                    std::shared_ptr<Curl> curl(new Curl());
+                    curl->Init();
+                    return [curl, &url](const std::string &body, std::string &out) -> long {
+                        return curl->Post(url, body, &out) ? curl->ResponseCode() : 0;
+                    };
+                }, c, load, opt, t);
+            } else if (!strcmp(mode, "pooled")) {
+                CurlContext ctx(0, (size_t)c);
+                run_blocking([&]() {
+                    return [&ctx, &url](const std::string &body, std::string &out) -> long {
+                        auto curl = ctx.Handles().get(1000);
+                        if (!curl) {
+                            return 0;
+                        }
+                        return curl->Post(url, body, &out) ? curl->ResponseCode() : 0;
+                    };
+                }, c, load, opt, t);
+            } else {
+                run_async(url, c, load, opt, t);
+            }
+
+            bench::result r;
+            r.bench = "curl_load";
+            r.variant = variant;
+            r.producers = c;
+            r.consumers = load.server.threads;
+            r.payload = (int)load.server.response_bytes;
+            r.ops = t.ok.load();
+            r.elapsed_ns = bench::now_ns() - start;
+            r.latency_ns = t.latency.snap();
+            r.print(opt);
+            if (t.errors.load()) {
+                fprintf(stderr, "%s concurrency %d: %llu failed requests\n", variant.c_str(), c,
+                    (unsigned long long)t.errors.load());
+            }
+        }
+    }
+    return 0;
+}
@@ -0,0 +1,550 @@
+#pragma once
+
+#ifndef __TML_MOCK_HTTP_SERVER_INC__
+#define __TML_MOCK_HTTP_SERVER_INC__
+
+#include <atomic>
+#include <memory>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+#include <queue>
+#include <unordered_map>
+#include <cerrno>
+#include <cstdint>
+#include <cstring>
+#include <cstdlib>
+#include <strings.h>
+
+#include <unistd.h>
+#include <fcntl.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <arpa/inet.h>
+#include <sys/socket.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/timerfd.h>
+
+#include "bench_util.h"
+
+namespace bench {
+
+enum latency_dist {
+    LATENCY_FIXED,          //always latency_us
+    LATENCY_UNIFORM,        //uniform in [0, 2 * latency_us]
+    LATENCY_EXPONENTIAL,    //exponential with mean latency_us
+};
+
+struct mock_options {
+    int threads;            //event loops, connections are spread over them by the kernel
+    latency_dist dist;
+    uint64_t latency_us;
+    //tail_ratio of the requests wait another tail_us on top, e.g. a slow replica or a gc pause
+    double tail_ratio;
+    uint64_t tail_us;
+    size_t response_bytes;
+    //error_rate of the requests are answered with error_status
+    double error_rate;
+    int error_status;
+    //answer with the request line and headers instead of response_bytes, for tests
+    //that check what a client actually sent
+    bool echo_head;
+    //answer with the request body, e.g. to round-trip a batched payload
+    bool echo_body;
+
+    mock_options() : threads(2), dist(LATENCY_FIXED), latency_us(0), tail_ratio(0), tail_us(0),
+        response_bytes(64), error_rate(0), error_status(500), echo_head(false), echo_body(false) {
+    }
+};
+
+//HTTP/1.1 server bound to 127.0.0.1 that answers every request with response_bytes
+//after a latency drawn from the configured distribution, for benchmarking clients
+//without a live service. keep-alive and pipelining work, the request body is read
+//and discarded unless echoed. delays are timers on the event loop, so thousands of
+//requests can be waiting at once without a thread each.
+class mock_http_server {
+public:
+    explicit mock_http_server(const mock_options &opt = mock_options())
+        : opt(opt), listen_port(0), served(0), failed(0) {
+        body.assign(opt.response_bytes, 'x');
+    }
+
+    ~mock_http_server() {
+        stop();
+    }
+
+    mock_http_server(const mock_http_server &) = delete;
+    mock_http_server &operator=(const mock_http_server &) = delete;
+
+    //port 0 picks a free one, see port()
+    bool start(int port = 0) {
+        int threads = opt.threads > 0 ? opt.threads : 1;
+        for (int i = 0; i < threads; i++) {
+            std::unique_ptr<worker> w(new worker(this, i));
+            //every loop listens on the same port, SO_REUSEPORT lets the kernel balance accepts
+            if (!w->open(i == 0 ? port : listen_port)) {
+                stop();
+                return false;
+            }
+            if (i == 0) {
+                listen_port = w->bound_port();
+            }
+            workers.push_back(std::move(w));
+        }
+        for (auto &w : workers) {
+            w->thread = std::thread(&worker::run, w.get());
+        }
+        return true;
+    }
+
+    void stop() {
+        for (auto &w : workers) {
+            w->wake_stop();
+        }
+        for (auto &w : workers) {
+            if (w->thread.joinable()) {
+                w->thread.join();
+            }
+        }
+        workers.clear();
+    }
+
+    int port() const {
+        return listen_port;
+    }
+
+    std::string url(const std::string &path = "/") const {
+        return "http://127.0.0.1:" + std::to_string(listen_port) + path;
+    }
+
+    //responses sent, and how many of them were injected errors
+    uint64_t requests() const {
+        return served.load(std::memory_order_relaxed);
+    }
+
+    uint64_t errors() const {
+        return failed.load(std::memory_order_relaxed);
+    }
+
+private:
+    struct connection {
+        int fd;
+        uint64_t id;
+        std::string in;
+        std::string out;
+        size_t out_sent;
+        std::string echo;   //head or body of the request being answered, with echo_head or echo_body
+        bool busy;          //a response is being delayed, later requests wait in `in`
+        bool close_after;
+        bool want_write;    //EPOLLOUT is armed until out drains
+        bool continued;     //100 Continue already sent for the request at the front of `in`
+
+        connection(int fd, uint64_t id) : fd(fd), id(id), out_sent(0), busy(false), close_after(false), want_write(false),
+            continued(false) {
+        }
+    };
+
+    struct timer {
+        uint64_t due_ns;
+        int fd;
+        uint64_t id;        //the fd may have been closed and reused by the time it fires
+        bool error;
+        bool close_after;
+
+        bool operator>(const timer &o) const {
+            return due_ns > o.due_ns;
+        }
+    };
+
+    class worker {
+    public:
+        std::thread thread;
+
+        worker(mock_http_server *server, int seed)
+            : server(server), listen_fd(-1), epoll_fd(-1), wake_fd(-1), timer_fd(-1), armed_ns(0), next_id(1), stopping(false),
+              rng((uint64_t)now_ns() + seed) {
+        }
+
+        ~worker() {
+            for (auto &it : conns) {
+                ::close(it.first);
+            }
+            if (listen_fd >= 0) {
+                ::close(listen_fd);
+            }
+            if (epoll_fd >= 0) {
+                ::close(epoll_fd);
+            }
+            if (wake_fd >= 0) {
+                ::close(wake_fd);
+            }
+            if (timer_fd >= 0) {
+                ::close(timer_fd);
+            }
+        }
+
+        bool open(int port) {
+            listen_fd = ::socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+            if (listen_fd < 0) {
+                return false;
+            }
+            int one = 1;
+            ::setsockopt(listen_fd, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+            ::setsockopt(listen_fd, SOL_SOCKET, SO_REUSEPORT, &one, sizeof(one));
+            sockaddr_in addr;
+            memset(&addr, 0, sizeof(addr));
+            addr.sin_family = AF_INET;
+            addr.sin_port = htons((uint16_t)port);
+            addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+            if (::bind(listen_fd, (sockaddr *)&addr, sizeof(addr)) < 0 || ::listen(listen_fd, 1024) < 0) {
+                return false;
+            }
+            epoll_fd = ::epoll_create1(EPOLL_CLOEXEC);
+            wake_fd = ::eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+            timer_fd = ::timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC);
+            if (epoll_fd < 0 || wake_fd < 0 || timer_fd < 0) {
+                return false;
+            }
+            return watch(listen_fd, EPOLLIN) && watch(wake_fd, EPOLLIN) && watch(timer_fd, EPOLLIN);
+        }
+
+        int bound_port() const {
+            sockaddr_in addr;
+            socklen_t len = sizeof(addr);
+            if (::getsockname(listen_fd, (sockaddr *)&addr, &len) < 0) {
+                return 0;
+            }
+            return ntohs(addr.sin_port);
+        }
+
+        void wake_stop() {
+            stopping.store(true);
+            uint64_t one = 1;
+            if (wake_fd >= 0) {
+                ssize_t n = ::write(wake_fd, &one, sizeof(one));
+                (void)n;
+            }
+        }
+
+        void run() {
+            epoll_event events[256];
+            while (!stopping.load()) {
+                arm_timer();
+                int n = ::epoll_wait(epoll_fd, events, 256, -1);
+                for (int i = 0; i < n; i++) {
+                    int fd = events[i].data.fd;
+                    if (fd == listen_fd) {
+                        accept_all();
+                    } else if (fd == timer_fd) {
+                        uint64_t expirations;
+                        ssize_t r = ::read(timer_fd, &expirations, sizeof(expirations));
+                        (void)r;
+                        armed_ns = 0;
+                    } else if (fd != wake_fd) {
+                        on_event(fd, events[i].events);
+                    }
+                }
+                fire_timers();
+            }
+        }
+
+    private:
+        bool watch(int fd, uint32_t events) {
+            epoll_event ev;
+            memset(&ev, 0, sizeof(ev));
+            ev.events = events;
+            ev.data.fd = fd;
+            return ::epoll_ctl(epoll_fd, EPOLL_CTL_ADD, fd, &ev) == 0;
+        }
+
+        //epoll_wait only has ms resolution, a timerfd gives sub-ms latencies
+        void arm_timer() {
+            if (timers.empty() || timers.top().due_ns == armed_ns) {
+                return;
+            }
+            //steady_clock is CLOCK_MONOTONIC, due_ns works as an absolute expiry
+            armed_ns = timers.top().due_ns;
+            itimerspec spec;
+            memset(&spec, 0, sizeof(spec));
+            spec.it_value.tv_sec = (time_t)(armed_ns / 1000000000);
+            spec.it_value.tv_nsec = (long)(armed_ns % 1000000000);
+            ::timerfd_settime(timer_fd, TFD_TIMER_ABSTIME, &spec, NULL);
+        }
+
+        void rewatch(int fd, uint32_t events) {
+            epoll_event ev;
+            memset(&ev, 0, sizeof(ev));
+            ev.events = events;
+            ev.data.fd = fd;
+            ::epoll_ctl(epoll_fd, EPOLL_CTL_MOD, fd, &ev);
+        }
+
+        void accept_all() {
+            while (true) {
+                int fd = ::accept4(listen_fd, NULL, NULL, SOCK_NONBLOCK | SOCK_CLOEXEC);
+                if (fd < 0) {
+                    return;
+                }
+                int one = 1;
+                ::setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+                conns[fd].reset(new connection(fd, next_id++));
+                watch(fd, EPOLLIN | EPOLLRDHUP);
+            }
+        }
+
+        void on_event(int fd, uint32_t events) {
+            auto it = conns.find(fd);
+            if (it == conns.end()) {
+                return;
+            }
+            connection *c = it->second.get();
+            //a response can close the connection and free c, stop touching it then
+            if (events & EPOLLOUT) {
+                if (!flush(c) || !next_request(c)) {
+                    return;
+                }
+            }
+            if (events & (EPOLLIN | EPOLLRDHUP | EPOLLHUP | EPOLLERR)) {
+                char buf[16384];
+                while (true) {
+                    ssize_t r = ::read(fd, buf, sizeof(buf));
+                    if (r > 0) {
+                        c->in.append(buf, (size_t)r);
+                        continue;
+                    }
+                    if (r == 0 || (errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR)) {
+                        close_conn(fd);
+                        return;
+                    }
+                    if (errno != EINTR) {
+                        break;
+                    }
+                }
+                next_request(c);
+            }
+        }
+
+        //start on the next complete request in c->in unless one is still being answered.
+        //false when answering closed the connection
+        bool next_request(connection *c) {
+            if (c->busy || c->out_sent < c->out.size()) {
+                return true;
+            }
+            size_t end = c->in.find("\r\n\r\n");
+            if (end == std::string::npos) {
+                return true;
+            }
+            size_t length = 0;
+            bool close_after = false;
+            bool chunked = false;
+            bool expect_continue = false;
+            //header names are case-insensitive, scan line by line
+            size_t pos = c->in.find("\r\n") + 2;
+            while (pos < end) {
+                size_t eol = c->in.find("\r\n", pos);
+                const char *line = c->in.c_str() + pos;
+                if (!strncasecmp(line, "content-length:", 15)) {
+                    length = strtoull(line + 15, NULL, 10);
+                } else if (!strncasecmp(line, "connection:", 11)) {
+                    close_after = c->in.compare(pos + 11, eol - pos - 11, " close") == 0;
+                } else if (!strncasecmp(line, "transfer-encoding:", 18)) {
+                    chunked = strcasestr(std::string(c->in, pos + 18, eol - pos - 18).c_str(), "chunked") != NULL;
+                } else if (!strncasecmp(line, "expect:", 7)) {
+                    expect_continue = strcasestr(std::string(c->in, pos + 7, eol - pos - 7).c_str(), "100-continue") != NULL;
+                }
+                pos = eol + 2;
+            }
+            std::string body;
+            size_t request_end = end + 4 + length;
+            bool complete = chunked ? dechunk(c->in, end + 4, body, request_end) : c->in.size() >= request_end;
+            if (!complete) {
+                //the client holds the body back until it hears from us
+                if (expect_continue && !c->continued) {
+                    c->continued = true;
+                    c->out.append("HTTP/1.1 100 Continue\r\n\r\n");
+                    return flush(c);
+                }
+                return true;
+            }
+            c->continued = false;
+            if (server->opt.echo_head) {
+                c->echo.assign(c->in, 0, end + 4);
+            } else if (server->opt.echo_body) {
+                if (chunked) {
+                    c->echo.swap(body);
+                } else {
+                    c->echo.assign(c->in, end + 4, length);
+                }
+            }
+            c->in.erase(0, request_end);
+
+            std::uniform_real_distribution<double> coin(0.0, 1.0);
+            bool error = server->opt.error_rate > 0 && coin(rng) < server->opt.error_rate;
+            uint64_t delay = draw_latency();
+            if (server->opt.tail_ratio > 0 && coin(rng) < server->opt.tail_ratio) {
+                delay += server->opt.tail_us;
+            }
+            if (delay == 0) {
+                return respond(c, error, close_after);
+            }
+            c->busy = true;
+            timer t;
+            t.due_ns = now_ns() + delay * 1000;
+            t.fd = c->fd;
+            t.id = c->id;
+            t.error = error;
+            t.close_after = close_after;
+            timers.push(t);
+            return true;
+        }
+
+        //decodes a chunked body starting at from. false until the last chunk and
+        //trailers are in, then end is one past the request
+        static bool dechunk(const std::string &in, size_t from, std::string &body, size_t &end) {
+            size_t pos = from;
+            while (true) {
+                size_t eol = in.find("\r\n", pos);
+                if (eol == std::string::npos) {
+                    return false;
+                }
+                size_t size = strtoull(in.c_str() + pos, NULL, 16);
+                pos = eol + 2;
+                if (size == 0) {
+                    break;
+                }
+                if (in.size() < pos + size + 2) {
+                    return false;
+                }
+                body.append(in, pos, size);
+                pos += size + 2;
+            }
+            //trailer lines up to an empty one
+            while (true) {
+                size_t eol = in.find("\r\n", pos);
+                if (eol == std::string::npos) {
+                    return false;
+                }
+                if (eol == pos) {
+                    end = pos + 2;
+                    return true;
+                }
+                pos = eol + 2;
+            }
+        }
+
+        uint64_t draw_latency() {
+            const mock_options &opt = server->opt;
+            if (opt.latency_us == 0) {
+                return 0;
+            }
+            switch (opt.dist) {
+            case LATENCY_UNIFORM:
+                return std::uniform_int_distribution<uint64_t>(0, 2 * opt.latency_us)(rng);
+            case LATENCY_EXPONENTIAL:
+                return (uint64_t)std::exponential_distribution<double>(1.0 / opt.latency_us)(rng);
+            default:
+                return opt.latency_us;
+            }
+        }
+
+        void fire_timers() {
+            uint64_t now = now_ns();
+            while (!timers.empty() && timers.top().due_ns <= now) {
+                timer t = timers.top();
+                timers.pop();
+                auto it = conns.find(t.fd);
+                if (it == conns.end() || it->second->id != t.id) {
+                    continue;
+                }
+                it->second->busy = false;
+                respond(it->second.get(), t.error, t.close_after);
+            }
+        }
+
+        //false when the connection was closed after the response
+        bool respond(connection *c, bool error, bool close_after) {
+            const std::string &body = server->opt.echo_head || server->opt.echo_body ? c->echo : server->body;
+            int status = error ? server->opt.error_status : 200;
+            char head[160];
+            int n = snprintf(head, sizeof(head), "HTTP/1.1 %d %s\r\nContent-Type: application/octet-stream\r\nContent-Length: %zu\r\n%s\r\n",
+                status, error ? "Error" : "OK", error ? (size_t)0 : body.size(), close_after ? "Connection: close\r\n" : "");
+            c->out.erase(0, c->out_sent);
+            c->out_sent = 0;
+            c->out.append(head, (size_t)n);
+            if (!error) {
+                c->out.append(body);
+            }
+            c->close_after = close_after;
+            server->served.fetch_add(1, std::memory_order_relaxed);
+            if (error) {
+                server->failed.fetch_add(1, std::memory_order_relaxed);
+            }
+            return flush(c) && next_request(c);
+        }
+
+        //false when the connection went away
+        bool flush(connection *c) {
+            while (c->out_sent < c->out.size()) {
+                ssize_t w = ::send(c->fd, c->out.data() + c->out_sent, c->out.size() - c->out_sent, MSG_NOSIGNAL);
+                if (w > 0) {
+                    c->out_sent += (size_t)w;
+                    continue;
+                }
+                if (w < 0 && errno == EINTR) {
+                    continue;
+                }
+                if (w < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+                    if (!c->want_write) {
+                        c->want_write = true;
+                        rewatch(c->fd, EPOLLIN | EPOLLOUT | EPOLLRDHUP);
+                    }
+                    return true;
+                }
+                close_conn(c->fd);
+                return false;
+            }
+            c->out.clear();
+            c->out_sent = 0;
+            if (c->close_after) {
+                close_conn(c->fd);
+                return false;
+            }
+            if (c->want_write) {
+                c->want_write = false;
+                rewatch(c->fd, EPOLLIN | EPOLLRDHUP);
+            }
+            return true;
+        }
+
+        void close_conn(int fd) {
+            ::epoll_ctl(epoll_fd, EPOLL_CTL_DEL, fd, NULL);
+            ::close(fd);
+            conns.erase(fd);
+        }
+
+        mock_http_server *server;
+        int listen_fd;
+        int epoll_fd;
+        int wake_fd;
+        int timer_fd;
+        uint64_t armed_ns;  //expiry the timerfd is set to, 0 when it is not
+        uint64_t next_id;
+        std::atomic<bool> stopping;
+        std::mt19937_64 rng;
+        std::unordered_map<int, std::unique_ptr<connection> > conns;
+        std::priority_queue<timer, std::vector<timer>, std::greater<timer> > timers;
+    };
+
+    mock_options opt;
+    std::string body;
+    int listen_port;
+    std::atomic<uint64_t> served;
+    std::atomic<uint64_t> failed;
+    std::vector<std::unique_ptr<worker> > workers;
+};
+
+}
+
+#endif //__TML_MOCK_HTTP_SERVER_INC__
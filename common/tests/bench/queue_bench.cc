@@ -0,0 +1,117 @@
+//throughput/latency sweep over the task queue variants.
+//latency is enqueue-to-dequeue time per task, measured by the consumer.
+#include <atomic>
+#include <memory>
+#include <thread>
+#include <vector>
+#include <string>
+
+#include "bench_util.h"
+#include "task_queue.h"
+#include "lockfree_queue.h"
+
+template<int N>
+struct payload {
+    uint64_t stamp;
+    char data[N - sizeof(uint64_t)];
+};
+
+template<typename Queue, int N>
+bench::result run(Queue &q, const std::string &variant, int producers, int consumers, const bench::options &opt) {
+    typedef payload<N> task;
+    const uint64_t per_producer = opt.ops / producers;
+    const uint64_t total = per_producer * producers;
+    std::atomic<uint64_t> consumed(0);
+    common::histogram latency;
+
+    std::vector<std::thread> threads;
+    uint64_t start = bench::now_ns();
+    for (int i = 0; i < consumers; i++) {
+        threads.push_back(std::thread([&]() {
+            while (consumed.load(std::memory_order_relaxed) < total) {
+                task *t = q.pop(1);
+                if (!t) {
+                    continue;
+                }
+                latency.record(bench::now_ns() - t->stamp);
+                //touch the payload like a real consumer would
+                volatile char sink = t->data[0] ^ t->data[N - sizeof(uint64_t) - 1];
+                (void)sink;
+                delete t;
+                consumed.fetch_add(1, std::memory_order_relaxed);
+            }
+        }));
+    }
+    for (int i = 0; i < producers; i++) {
+        threads.push_back(std::thread([&]() {
+            for (uint64_t k = 0; k < per_producer; k++) {
+                task *t = new task();
+                t->data[0] = (char)k;
+                t->stamp = bench::now_ns();
+                while (!q.push(t)) {
+                    std::this_thread::yield();
+                }
+            }
+        }));
+    }
+    for (size_t i = 0; i < threads.size(); i++) {
+        threads[i].join();
+    }
+
+    bench::result r;
+    r.bench = "task_queue";
+    r.variant = variant;
+    r.producers = producers;
+    r.consumers = consumers;
+    r.payload = N;
+    r.ops = total;
+    r.elapsed_ns = bench::now_ns() - start;
+    r.latency_ns = latency.snap();
+    return r;
+}
+
+template<int N>
+void sweep(const bench::options &opt) {
+    typedef payload<N> task;
+    const int producer_counts[] = { 1, 2, 4, 8 };
+    const int consumer_counts[] = { 1, 2, 4 };
+    const size_t CAPACITY = 1024;
+
+    for (int p : producer_counts) {
+        for (int c : consumer_counts) {
+            if (opt.selected("mpmc")) {
+                std::unique_ptr<common::task_queue<task> > q(new common::task_queue<task>());
+                run<common::task_queue<task>, N>(*q, "mpmc", p, c, opt).print(opt);
+            }
+            if (opt.selected("mpmc_bounded")) {
+                std::unique_ptr<common::task_queue<task> > q(new common::task_queue<task>(CAPACITY));
+                run<common::task_queue<task>, N>(*q, "mpmc_bounded", p, c, opt).print(opt);
+            }
+            if (opt.selected("lockfree")) {
+                std::unique_ptr<common::lockfree_queue<task> > q(new common::lockfree_queue<task>(CAPACITY));
+                run<common::lockfree_queue<task>, N>(*q, "lockfree", p, c, opt).print(opt);
+            }
+            if (c == 1 && opt.selected("mpsc")) {
+                typedef common::task_queue<task, common::mpsc> queue;
+                std::unique_ptr<queue> q(new queue());
+                run<queue, N>(*q, "mpsc", p, c, opt).print(opt);
+            }
+            if (p == 1 && c == 1 && opt.selected("spsc")) {
+                typedef common::task_queue<task, common::spsc> queue;
+                std::unique_ptr<queue> q(new queue(CAPACITY));
+                run<queue, N>(*q, "spsc", p, c, opt).print(opt);
+            }
+        }
+    }
+}
+
+int main(int argc, char *argv[]) {
+    bench::options opt;
+    if (!opt.parse(argc, argv)) {
+        return 1;
+    }
+    sweep<16>(opt);
+    sweep<256>(opt);
+    sweep<4096>(opt);
+    return 0;
+}
@@ -0,0 +1,109 @@
+#include "ConnectionPool.h"
+#include <atomic>
+#include <chrono>
+#include <iostream>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+typedef std::chrono::steady_clock clock_type;
+
+//fails its first `fails` reconnects and remembers when each attempt was made
+class connection {
+public:
+    explicit connection(int fails = 0) : fails(fails) {
+    }
+
+    bool reconnect() {
+        std::unique_lock<std::mutex> lock(mutex);
+        attempts.push_back(clock_type::now());
+        return fails-- <= 0;
+    }
+
+    std::vector<long> gaps_ms() {
+        std::unique_lock<std::mutex> lock(mutex);
+        std::vector<long> gaps;
+        for (size_t i = 1; i < attempts.size(); i++) {
+            gaps.push_back((long)std::chrono::duration_cast<std::chrono::milliseconds>(attempts[i] - attempts[i - 1]).count());
+        }
+        return gaps;
+    }
+
+    size_t tries() {
+        std::unique_lock<std::mutex> lock(mutex);
+        return attempts.size();
+    }
+
+private:
+    int fails;
+    std::mutex mutex;
+    std::vector<clock_type::time_point> attempts;
+};
+
+typedef common::connection_pool<connection, common::pool_stats> pool_type;
+
+//the first retry is immediate, then the delay doubles from min up to max with
+//+-50% jitter, and the connection isn't handed out until a reconnect succeeds
+bool test_backoff() {
+    bool ok = true;
+    pool_type pool;
+    pool.set_reconnect_backoff(20, 40, 0);
+    connection a(3);
+    pool.add(&a);
+
+    clock_type::time_point start = clock_type::now();
+    pool.get(100).mark_invalid();
+    //still backing off, nothing to hand out
+    ok = ok && !pool.get(5);
+    auto back = pool.get(2000);
+    long waited = (long)std::chrono::duration_cast<std::chrono::milliseconds>(clock_type::now() - start).count();
+    ok = ok && back;
+
+    std::vector<long> gaps = a.gaps_ms();
+    const long delays[] = { 20, 40, 40 };
+    ok = ok && gaps.size() == 3;
+    std::cout << "backoff gaps:";
+    for (size_t i = 0; i < gaps.size() && i < 3; i++) {
+        std::cout << " " << gaps[i];
+        //the upper bound leaves room for a slow scheduler
+        ok = ok && gaps[i] >= delays[i] / 2 && gaps[i] <= delays[i] + delays[i] / 2 + 100;
+    }
+    std::cout << " ms, back after " << waited << " ms" << std::endl;
+
+    back.release();
+    pool_type::stats_snapshot s = pool.snap();
+    ok = ok && s.reconnects == 1 && s.reconnect_failures == 3 && s.bad == 0 && s.idle == 1;
+    return ok;
+}
+
+//a connection that fails its probe goes through the same reconnect path
+bool test_health_probe() {
+    bool ok = true;
+    pool_type pool;
+    pool.set_reconnect_backoff(20, 40, 0);
+    connection a(1);
+    pool.add(&a);
+    std::atomic<int> probes(0);
+    pool.set_health_probe([&](connection *) {
+        return probes++ > 0;
+    }, 10);
+
+    for (int i = 0; i < 200 && a.tries() < 2; i++) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(5));
+    }
+    auto l = pool.get(1000);
+    std::vector<long> gaps = a.gaps_ms();
+    ok = ok && l && a.tries() == 2 && gaps.size() == 1 && gaps[0] >= 10;
+    l.release();
+    pool_type::stats_snapshot s = pool.snap();
+    std::cout << "probes: " << probes << ", reconnects: " << s.reconnects << ", failures: " << s.reconnect_failures << std::endl;
+    ok = ok && s.reconnects == 1 && s.reconnect_failures == 1;
+    return ok;
+}
+
+int main(int argc, char *argv[]) {
+    bool ok = test_backoff();
+    ok = test_health_probe() && ok;
+    std::cout << (ok ? "OK" : "FAILED") << std::endl;
+    return ok ? 0 : 1;
+}
@@ -0,0 +1,135 @@
+#include "ConnectionPool.h"
+#include <atomic>
+#include <iostream>
+#include <thread>
+
+std::atomic<int> created(0);
+std::atomic<int> destroyed(0);
+std::atomic<bool> backend_up(true);
+std::atomic<int> factory_failures(0);
+
+class connection {
+public:
+    connection() {
+        created++;
+    }
+
+    ~connection() {
+        destroyed++;
+    }
+
+    bool reconnect() {
+        return backend_up.load();
+    }
+};
+
+connection *make() {
+    if (factory_failures.fetch_sub(1) > 0) {
+        return NULL;
+    }
+    return new connection();
+}
+
+//without auto reconnect every invalidated connection is closed and its slot reused,
+//so a pool at max_size doesn't run dry
+bool test_no_reconnect() {
+    created = destroyed = 0;
+    bool ok = true;
+    {
+        common::connection_pool<connection> pool(false);
+        pool.set_factory(make);
+        pool.set_limits(0, 2);
+        {
+            auto a = pool.get(100);
+            auto b = pool.get(100);
+            ok = ok && a && b && pool.size() == 2;
+            a.mark_invalid();
+            b.mark_invalid();
+        }
+        ok = ok && pool.size() == 0 && destroyed == 2;
+        auto c = pool.get(100);
+        auto d = pool.get(100);
+        ok = ok && c && d && pool.size() == 2 && created == 4;
+
+        //a caller blocked on a full pool gets the replacement of an invalidated one
+        std::atomic<bool> got(false);
+        std::thread waiter([&]() {
+            auto e = pool.get(0);
+            got = (bool)e;
+        });
+        std::this_thread::sleep_for(std::chrono::milliseconds(20));
+        c.mark_invalid();
+        waiter.join();
+        ok = ok && got && created == 5 && destroyed == 3;
+    }
+    std::cout << "no reconnect: created " << created << ", destroyed " << destroyed << std::endl;
+    return ok && destroyed == 5;
+}
+
+//with auto reconnect a factory-made connection that never comes back is given up
+//after max_attempts and replaced by a fresh one once the backend is back
+bool test_reconnect_limit() {
+    created = destroyed = 0;
+    backend_up = false;
+    bool ok = true;
+    {
+        common::connection_pool<connection> pool;
+        pool.set_factory(make);
+        pool.set_limits(0, 1);
+        pool.set_reconnect_backoff(1, 2, 3);
+        pool.get(100).mark_invalid();
+        for (int i = 0; i < 100 && destroyed == 0; i++) {
+            std::this_thread::sleep_for(std::chrono::milliseconds(5));
+        }
+        ok = ok && destroyed == 1 && pool.size() == 0;
+        backend_up = true;
+        auto a = pool.get(100);
+        ok = ok && a && created == 2;
+    }
+    std::cout << "reconnect limit: created " << created << ", destroyed " << destroyed << std::endl;
+    return ok;
+}
+
+//fair mode: the factory fails when a retired connection is replaced and again when
+//the head of the queue retries it, the retry after backoff still serves both waiters
+bool test_fair_refill() {
+    created = destroyed = 0;
+    bool ok = true;
+    {
+        common::connection_pool<connection> pool(false);
+        pool.set_factory(make);
+        pool.set_limits(0, 1);
+        pool.set_reconnect_backoff(10, 20);
+        pool.set_fair(true);
+        auto a = pool.get(100);
+
+        std::atomic<int> got(0);
+        std::thread forever([&]() {
+            auto l = pool.get(0);
+            got += (bool)l;
+        });
+        std::thread timed([&]() {
+            auto l = pool.get(2000);
+            got += (bool)l;
+        });
+        std::this_thread::sleep_for(std::chrono::milliseconds(20));
+        factory_failures = 2;
+        auto start = std::chrono::steady_clock::now();
+        a.mark_invalid();
+        forever.join();
+        timed.join();
+        long ms = (long)std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - start).count();
+        std::cout << "fair refill: served " << got << " after " << ms << " ms" << std::endl;
+        ok = ok && got == 2 && ms < 1000 && created == 2 && pool.size() == 1;
+    }
+    factory_failures = 0;
+    return ok && destroyed == 2;
+}
+
+int main(int argc, char *argv[]) {
+    bool ok = test_no_reconnect();
+    ok = test_reconnect_limit() && ok;
+    ok = test_fair_refill() && ok;
+    std::cout << (ok ? "OK" : "FAILED") << std::endl;
+    return ok ? 0 : 1;
+}
@@ -0,0 +1,120 @@
+#include "ConnectionPool.h"
+#include <atomic>
+#include <iostream>
+#include <thread>
+#include <vector>
+#include <functional>
+
+class connection {
+public:
+    bool reconnect() {
+        return true;
+    }
+};
+
+const int WAITER_COUNT = 8;
+const int STRESS_THREAD_COUNT = 16;
+const int STRESS_CONNECTIONS = 4;
+const int ROUNDS = 2000;
+
+std::atomic<int> queued(0);
+std::atomic<int> served(0);
+int order[WAITER_COUNT];
+
+void waiter_func(common::connection_pool<connection> *pool, int index) {
+    queued++;
+    auto conn = pool->get();
+    order[served++] = index;
+    std::this_thread::sleep_for(std::chrono::milliseconds(1));
+}
+
+//waiters queued one after another must be served in the same order
+bool fifo_order() {
+    common::connection_pool<connection> pool(false);
+    pool.set_fair(true);
+    connection c;
+    pool.add(&c);
+    auto held = pool.get();
+
+    std::vector<std::thread> td;
+    for (int i = 0; i < WAITER_COUNT; i++) {
+        td.push_back(std::thread(std::bind(waiter_func, &pool, i)));
+        while (queued <= i) {
+            std::this_thread::yield();
+        }
+        std::this_thread::sleep_for(std::chrono::milliseconds(20));
+    }
+    held.release();
+    for (size_t i = 0; i < td.size(); i++) {
+        td[i].join();
+    }
+
+    bool ok = served == WAITER_COUNT;
+    for (int i = 0; i < WAITER_COUNT; i++) {
+        ok = ok && order[i] == i;
+    }
+    std::cout << "fifo order: " << (ok ? "ok" : "broken") << std::endl;
+    return ok;
+}
+
+//a timed out waiter leaves the queue, the next release must not be lost on it
+bool timeout() {
+    common::connection_pool<connection> pool(false);
+    pool.set_fair(true);
+    connection c;
+    pool.add(&c);
+    auto held = pool.get();
+
+    auto start = std::chrono::steady_clock::now();
+    auto late = pool.get(50);
+    long ms = (long)std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - start).count();
+    held.release();
+    auto again = pool.get(10);
+    std::cout << "timed out after " << ms << " ms" << std::endl;
+    return !late && ms >= 50 && again.get() == &c;
+}
+
+//many short waits with timeouts, every connection must be back at the end
+bool stress() {
+    common::connection_pool<connection> pool(false);
+    pool.set_fair(true);
+    connection conns[STRESS_CONNECTIONS];
+    for (int i = 0; i < STRESS_CONNECTIONS; i++) {
+        pool.add(&conns[i]);
+    }
+
+    std::atomic<int> leased(0);
+    std::vector<std::thread> td;
+    for (int i = 0; i < STRESS_THREAD_COUNT; i++) {
+        td.push_back(std::thread([&pool, &leased]() {
+            for (int k = 0; k < ROUNDS; k++) {
+                auto conn = pool.get(k % 2 ? 1 : 0);
+                if (conn) {
+                    leased++;
+                }
+            }
+        }));
+    }
+    for (size_t i = 0; i < td.size(); i++) {
+        td[i].join();
+    }
+
+    std::vector<common::connection_pool<connection>::lease> all;
+    for (int i = 0; i < STRESS_CONNECTIONS; i++) {
+        all.push_back(pool.get(10));
+    }
+    bool ok = true;
+    for (size_t i = 0; i < all.size(); i++) {
+        ok = ok && all[i];
+    }
+    std::cout << "leased: " << leased << ", all returned: " << (ok ? "yes" : "no") << std::endl;
+    return ok && leased >= STRESS_THREAD_COUNT * ROUNDS / 2;
+}
+
+int main(int argc, char *argv[]) {
+    bool ok = fifo_order();
+    ok = timeout() && ok;
+    ok = stress() && ok;
+    std::cout << (ok ? "OK" : "FAILED") << std::endl;
+    return ok ? 0 : 1;
+}
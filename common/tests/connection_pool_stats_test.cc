@@ -0,0 +1,62 @@
+#include "ConnectionPool.h"
+#include <atomic>
+#include <iostream>
+#include <thread>
+
+class connection {
+public:
+    connection() : fails(1) {
+    }
+
+    bool reconnect() {
+        return fails-- <= 0;
+    }
+
+private:
+    std::atomic<int> fails;
+};
+
+typedef common::connection_pool<connection, common::pool_stats> pool_type;
+
+int main(int argc, char *argv[]) {
+    bool ok = true;
+    pool_type pool;
+    pool.set_reconnect_backoff(5, 10);
+    connection a, b;
+    pool.add(&a);
+    pool.add(&b);
+
+    {
+        auto x = pool.get();
+        auto y = pool.get();
+        pool_type::lease z = pool.get(20);
+        pool_type::stats_snapshot s = pool.snap();
+        std::cout << "idle: " << s.idle << ", in use: " << s.in_use << ", timeouts: " << s.timeouts << std::endl;
+        ok = ok && !z && s.total == 2 && s.idle == 0 && s.in_use == 2 && s.timeouts == 1;
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+        y.mark_invalid();
+    }
+
+    //b fails its first reconnect and comes back on the second
+    auto p = pool.get(1000);
+    auto q = pool.get(1000);
+    ok = ok && p && q;
+    p.release();
+    q.release();
+    pool_type::stats_snapshot s = pool.snap();
+    std::cout << "acquires: " << s.acquires << ", reconnects: " << s.reconnects
+        << ", failures: " << s.reconnect_failures << ", lease max: " << s.lease_ns.max
+        << " ns, wait max: " << s.wait_ns.max << " ns" << std::endl;
+    ok = ok && s.idle == 2 && s.in_use == 0 && s.bad == 0 && s.waiting == 0;
+    ok = ok && s.acquires == 4 && s.reconnects == 1 && s.reconnect_failures == 1;
+    ok = ok && s.lease_ns.count == 4 && s.lease_ns.max >= 10000000 && s.wait_ns.count == 4;
+
+    //without stats only the gauges are there
+    common::connection_pool<connection> plain(false);
+    plain.add(&a);
+    auto l = plain.get();
+    ok = ok && plain.snap().in_use == 1 && plain.snap().idle == 0;
+
+    std::cout << (ok ? "OK" : "FAILED") << std::endl;
+    return ok ? 0 : 1;
+}
@@ -0,0 +1,67 @@
+//build with -std=c++20
+#include "task_queue.h"
+#include "ConnectionPool.h"
+#include "coro_scheduler.h"
+#include <atomic>
+#include <iostream>
+
+struct FackTask {
+    uint64_t id;
+};
+
+class connection {
+public:
+    bool reconnect() {
+        return true;
+    }
+};
+
+const int CONSUMER_COUNT = 10000;
+const int CONNECTION_COUNT = 4;
+
+std::atomic<uint64_t> checksum(0);
+std::atomic<int> finished(0);
+
+//every logical request waits for a task and then for a connection,
+//without holding an OS thread while suspended
+common::coro::task consumer(common::coro::scheduler &sched, common::task_queue<FackTask> &tasks,
+        common::connection_pool<connection> &pool) {
+    co_await sched.hop();
+    FackTask *t = co_await tasks.async_pop(sched);
+    auto conn = co_await pool.async_acquire(sched);
+    checksum += t->id;
+    delete t;
+    conn.release();
+    finished++;
+}
+
+int main(int argc, char *argv[]) {
+    common::task_queue<FackTask> tasks;
+    common::connection_pool<connection> pool(false);
+    connection conns[CONNECTION_COUNT];
+    for (int i = 0; i < CONNECTION_COUNT; i++) {
+        pool.add(&conns[i]);
+    }
+
+    common::coro::pool_scheduler sched(4);
+    for (int i = 0; i < CONSUMER_COUNT; i++) {
+        consumer(sched, tasks, pool);
+    }
+    for (int i = 0; i < CONSUMER_COUNT; i++) {
+        FackTask *t = new FackTask();
+        t->id = i;
+        tasks.push(t);
+    }
+    while (finished.load() != CONSUMER_COUNT) {
+        sched.wait();
+    }
+
+    uint64_t expect = (uint64_t)CONSUMER_COUNT * (CONSUMER_COUNT - 1) / 2;
+    std::cout << "finished: " << finished << ", checksum: " << checksum << ", expect: " << expect << std::endl;
+    if (checksum != expect || tasks.try_pop() != NULL) {
+        std::cout << "FAILED" << std::endl;
+        return 1;
+    }
+    std::cout << "OK" << std::endl;
+    return 0;
+}
@@ -0,0 +1,114 @@
+#include "CurlBatcher.h"
+#include "bench/mock_http_server.h"
+#include <iostream>
+
+bool ready(std::future<AsyncResponse> &f, int ms = 0) {
+    return f.wait_for(std::chrono::milliseconds(ms)) == std::future_status::ready;
+}
+
+//posts wait out lingerMs and go as one request, each caller gets back its own line,
+//empty payloads included
+bool test_linger(AsyncCurl &client, bench::mock_http_server &server) {
+    BatchOptions opt;
+    opt.lingerMs = 50;
+    CurlBatcher batcher(client, opt);
+    const char *payloads[] = { "{\"a\":1}", "", "{\"c\":3}", "{\"d\":4}", "" };
+    const size_t n = sizeof(payloads) / sizeof(payloads[0]);
+    uint64_t before = server.requests();
+
+    std::vector<std::future<AsyncResponse> > f;
+    for (size_t i = 0; i < n; i++) {
+        f.push_back(batcher.Post(server.url("/ingest"), payloads[i]));
+    }
+    std::future<AsyncResponse> other = batcher.Post(server.url("/other"), "x");
+    bool ok = !ready(f[0], 20);
+    for (size_t i = 0; i < n; i++) {
+        ok = ok && ready(f[i], 2000);
+        AsyncResponse resp = f[i].get();
+        ok = ok && resp.Ok() && resp.status == 200 && resp.body == payloads[i];
+    }
+    ok = ok && ready(other, 2000) && other.get().body == "x";
+    std::cout << "linger: requests " << server.requests() - before << std::endl;
+    //one per url
+    return ok && server.requests() - before == 2;
+}
+
+//maxCount sends right away, the destructor flushes the remainder
+bool test_limits(AsyncCurl &client, bench::mock_http_server &server) {
+    BatchOptions opt;
+    opt.lingerMs = 60000;
+    opt.maxCount = 4;
+    uint64_t before = server.requests();
+    std::vector<std::future<AsyncResponse> > f;
+    {
+        CurlBatcher batcher(client, opt);
+        for (int i = 0; i < 6; i++) {
+            f.push_back(batcher.Post(server.url("/ingest"), std::to_string(i)));
+        }
+        for (int i = 0; i < 4; i++) {
+            if (!ready(f[i], 2000) || f[i].get().body != std::to_string(i)) {
+                return false;
+            }
+        }
+    }
+    bool ok = true;
+    for (int i = 4; i < 6; i++) {
+        ok = ok && ready(f[i], 2000) && f[i].get().body == std::to_string(i);
+    }
+    std::cout << "limits: requests " << server.requests() - before << std::endl;
+    return ok && server.requests() - before == 2;
+}
+
+//a response that doesn't split into one part per post is an error for every caller
+bool test_split_mismatch(AsyncCurl &client, bench::mock_http_server &server) {
+    BatchOptions opt;
+    opt.lingerMs = 1;
+    opt.join = [](const std::vector<std::string> &payloads) {
+        std::string body;
+        for (size_t i = 0; i < payloads.size(); i++) {
+            body += payloads[i];
+        }
+        return body;
+    };
+    CurlBatcher batcher(client, opt);
+    std::future<AsyncResponse> a = batcher.Post(server.url("/ingest"), "ab");
+    std::future<AsyncResponse> b = batcher.Post(server.url("/ingest"), "cd");
+    bool ok = ready(a, 2000) && ready(b, 2000);
+    for (AsyncResponse resp : { a.get(), b.get() }) {
+        ok = ok && resp.code == CURLE_RECV_ERROR && resp.status == 200 && resp.body.empty();
+    }
+    return ok;
+}
+
+//with the default NDJSON join a payload holding a newline is refused up front,
+//the rest of the batch still goes out
+bool test_newline(AsyncCurl &client, bench::mock_http_server &server) {
+    BatchOptions opt;
+    opt.lingerMs = 1;
+    CurlBatcher batcher(client, opt);
+    std::future<AsyncResponse> a = batcher.Post(server.url("/ingest"), "a");
+    std::future<AsyncResponse> bad = batcher.Post(server.url("/ingest"), "b\nc");
+    std::future<AsyncResponse> d = batcher.Post(server.url("/ingest"), "d");
+    bool ok = ready(bad) && bad.get().code == CURLE_BAD_FUNCTION_ARGUMENT;
+    return ok && ready(a, 2000) && ready(d, 2000) && a.get().body == "a" && d.get().body == "d";
+}
+
+int main(int argc, char *argv[]) {
+    bench::mock_options opt;
+    opt.echo_body = true;
+    bench::mock_http_server server(opt);
+    if (!server.start()) {
+        std::cout << "FAILED to start server" << std::endl;
+        return 1;
+    }
+    AsyncCurl client;
+    client.Start();
+    bool ok = test_linger(client, server);
+    ok = test_limits(client, server) && ok;
+    ok = test_split_mismatch(client, server) && ok;
+    ok = test_newline(client, server) && ok;
+    client.Stop();
+    server.stop();
+    std::cout << (ok ? "OK" : "FAILED") << std::endl;
+    return ok ? 0 : 1;
+}
@@ -0,0 +1,67 @@
+#include "Curl.h"
+#include "bench/mock_http_server.h"
+#include <iostream>
+
+//post body and return the request head the server saw
+std::string sent_head(Curl &curl, const std::string &url, const CurlBody &body) {
+    std::string out;
+    if (!curl.Post(url, body, CurlSink(&out))) {
+        return "";
+    }
+    return out;
+}
+
+bool has(const std::string &head, const char *what) {
+    return head.find(what) != std::string::npos;
+}
+
+int main(int argc, char *argv[]) {
+    bench::mock_options opt;
+    opt.echo_head = true;
+    bench::mock_http_server server(opt);
+    if (!server.start()) {
+        std::cout << "FAILED to start server" << std::endl;
+        return 1;
+    }
+    const std::string url = server.url("/post");
+    const std::string big(4096, 'a');
+    const std::string small = "tiny";
+    bool ok = true;
+
+    Curl curl;
+    curl.Init();
+    std::vector<std::string> headers = { "X-Test: 1" };
+    curl.SetHeaders(headers);
+    ok = ok && curl.SetCompression(ENCODING_GZIP, 1024);
+
+    std::string head = sent_head(curl, url, CurlBody(big));
+    std::cout << "compressed: " << has(head, "Content-Encoding: gzip") << std::endl;
+    ok = ok && has(head, "Content-Encoding: gzip") && has(head, "X-Test: 1");
+
+    //below the threshold the plain list goes out again
+    head = sent_head(curl, url, CurlBody(small));
+    ok = ok && !has(head, "Content-Encoding") && has(head, "X-Test: 1");
+
+    //a streamed body is never compressed
+    sent_head(curl, url, CurlBody(big));
+    bool done = false;
+    head = sent_head(curl, url, CurlBody([&](char *buf, size_t len) -> size_t {
+        if (done) {
+            return 0;
+        }
+        done = true;
+        memcpy(buf, "x", 1);
+        return 1;
+    }));
+    ok = ok && !has(head, "Content-Encoding") && has(head, "X-Test: 1");
+
+    //turning compression off must not leave the encoded header list on the handle
+    sent_head(curl, url, CurlBody(big));
+    ok = ok && curl.SetCompression(ENCODING_IDENTITY);
+    head = sent_head(curl, url, CurlBody(big));
+    std::cout << "after off: " << has(head, "Content-Encoding") << std::endl;
+    ok = ok && !head.empty() && !has(head, "Content-Encoding") && has(head, "X-Test: 1");
+
+    std::cout << (ok ? "OK" : "FAILED") << std::endl;
+    return ok ? 0 : 1;
+}
@@ -0,0 +1,47 @@
+#include "Curl.h"
+#include "bench/mock_http_server.h"
+#include <chrono>
+#include <cstring>
+#include <iostream>
+
+//the mock server must understand how libcurl actually sends bodies:
+//chunked when it doesn't know the length, and Expect: 100-continue for large ones
+int main(int argc, char *argv[]) {
+    bench::mock_options opt;
+    opt.echo_body = true;
+    bench::mock_http_server server(opt);
+    if (!server.start()) {
+        std::cout << "FAILED to start server" << std::endl;
+        return 1;
+    }
+    const std::string url = server.url("/post");
+    bool ok = true;
+    Curl curl;
+    curl.Init();
+
+    //a streamed body goes out chunked
+    const char *parts[] = { "hel", "lo", "" };
+    size_t next = 0;
+    std::string out;
+    ok = ok && curl.Post(url, CurlBody([&](char *buf, size_t len) -> size_t {
+        size_t n = strlen(parts[next]);
+        memcpy(buf, parts[next], n);
+        next += n ? 1 : 0;
+        return n;
+    }), CurlSink(&out));
+    std::cout << "chunked: " << out << std::endl;
+    ok = ok && out == "hello";
+
+    //a large body waits for 100 Continue, without it libcurl stalls for a second
+    std::string big(2000000, 'b');
+    out.clear();
+    auto start = std::chrono::steady_clock::now();
+    ok = ok && curl.Post(url, CurlBody(big), CurlSink(&out));
+    long ms = (long)std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - start).count();
+    std::cout << "2 MB post: " << ms << " ms" << std::endl;
+    ok = ok && out == big && ms < 500;
+
+    server.stop();
+    std::cout << (ok ? "OK" : "FAILED") << std::endl;
+    return ok ? 0 : 1;
+}
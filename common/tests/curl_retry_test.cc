@@ -0,0 +1,160 @@
+#include "CurlRetryClient.h"
+#include "bench/mock_http_server.h"
+#include <iostream>
+
+AsyncRequest get(const std::string &url) {
+    AsyncRequest req;
+    req.url = url;
+    return req;
+}
+
+//against a backend that always fails, retries stop at maxAttempts per request and
+//at the token bucket across requests, and every caller still gets one answer
+bool test_budget() {
+    bench::mock_options opt;
+    opt.error_rate = 1.0;
+    opt.error_status = 503;
+    bench::mock_http_server server(opt);
+    if (!server.start()) {
+        return false;
+    }
+    AsyncCurl client;
+    client.Start();
+    bool ok = true;
+
+    RetryOptions plenty;
+    plenty.maxAttempts = 3;
+    plenty.backoffMinMs = 1;
+    plenty.backoffMaxMs = 2;
+    plenty.budgetBurst = 100;
+    CurlRetryClient limited(client, plenty);
+    AsyncResponse resp = limited.Submit(get(server.url("/")), true).get();
+    ok = ok && resp.Ok() && resp.status == 503 && server.requests() == 3;
+    //never retried without idempotence
+    limited.Submit(get(server.url("/")), false).get();
+    ok = ok && server.requests() == 4;
+
+    //3 spare tokens and 0.1 more per request: 10 requests buy 4 retries at most
+    RetryOptions tight = plenty;
+    tight.maxAttempts = 5;
+    tight.budgetRatio = 0.1;
+    tight.budgetBurst = 3;
+    CurlRetryClient budget(client, tight);
+    uint64_t before = server.requests();
+    int answered = 0;
+    for (int i = 0; i < 10; i++) {
+        answered += budget.Submit(get(server.url("/")), true).get().status == 503;
+    }
+    uint64_t sent = server.requests() - before;
+    std::cout << "budget: 10 requests went out as " << sent << " attempts" << std::endl;
+    ok = ok && answered == 10 && sent >= 10 + 3 && sent <= 10 + 4;
+
+    client.Stop();
+    server.stop();
+    return ok;
+}
+
+//sends n requests in waves of 100 and counts the ones that took longer than slow_ms
+int count_slow(CurlRetryClient &retry, const std::string &url, int n, long slow_ms) {
+    typedef std::chrono::steady_clock clock_type;
+    std::atomic<int> done(0), slow(0);
+    for (int i = 0; i < n; i++) {
+        clock_type::time_point start = clock_type::now();
+        retry.Submit(get(url), true, [&, start](AsyncResponse &resp) {
+            slow += resp.status != 200 || clock_type::now() - start > std::chrono::milliseconds(slow_ms);
+            done++;
+        });
+        while (i % 100 == 99 && done <= i) {
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        }
+    }
+    while (done < n) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+    return slow;
+}
+
+//once a window of latencies is in, a request still out after the p95 is sent again
+//and the fast copy wins, so the slow tail mostly disappears
+bool test_hedge() {
+    bench::mock_options opt;
+    opt.latency_us = 2000;
+    opt.tail_ratio = 0.02;
+    opt.tail_us = 300 * 1000;
+    bench::mock_http_server server(opt);
+    if (!server.start()) {
+        return false;
+    }
+    AsyncCurl client;
+    client.Start();
+    const std::string url = server.url("/");
+    const int N = 800;
+
+    RetryOptions ro;
+    ro.budgetRatio = 1.0;
+    ro.budgetBurst = 100;
+    CurlRetryClient plain(client, ro);
+    int unhedged = count_slow(plain, url, N, 200);
+
+    ro.hedge = true;
+    ro.hedgeQuantile = 0.95;
+    ro.hedgeWindow = 400;
+    CurlRetryClient hedged(client, ro);
+    bool ok = hedged.HedgeDelayMs() == 0;
+    //fills the first window, nothing is hedged yet
+    count_slow(hedged, url, 400, 200);
+    long delay = hedged.HedgeDelayMs();
+    ok = ok && delay > 0 && delay < 200;
+    int slow = count_slow(hedged, url, N, 200);
+
+    std::cout << "hedge: delay " << delay << " ms, slow " << slow << " of " << N
+        << ", " << unhedged << " without hedging" << std::endl;
+    //about 16 are slow without hedging, with it only those whose hedge is slow too
+    ok = ok && unhedged >= 4 && slow <= 3;
+
+    client.Stop();
+    server.stop();
+    return ok;
+}
+
+//attempts that lose to their hedge still count with the time they took, so the
+//delay stays near the real p95 instead of sliding down window by window
+bool test_hedge_window() {
+    bench::mock_options opt;
+    opt.dist = bench::LATENCY_EXPONENTIAL;
+    opt.latency_us = 10000;
+    bench::mock_http_server server(opt);
+    if (!server.start()) {
+        return false;
+    }
+    AsyncCurl client;
+    client.Start();
+    const std::string url = server.url("/");
+
+    RetryOptions ro;
+    ro.budgetRatio = 1.0;
+    ro.budgetBurst = 100;
+    ro.hedge = true;
+    ro.hedgeWindow = 200;
+    CurlRetryClient hedged(client, ro);
+    std::vector<long> delays;
+    std::cout << "hedge window delays:";
+    for (int i = 0; i < 8; i++) {
+        count_slow(hedged, url, 200, 1000);
+        delays.push_back(hedged.HedgeDelayMs());
+        std::cout << " " << delays.back();
+    }
+    std::cout << " ms" << std::endl;
+
+    client.Stop();
+    server.stop();
+    return delays.back() >= delays.front() / 2;
+}
+
+int main(int argc, char *argv[]) {
+    bool ok = test_budget();
+    ok = test_hedge() && ok;
+    ok = test_hedge_window() && ok;
+    std::cout << (ok ? "OK" : "FAILED") << std::endl;
+    return ok ? 0 : 1;
+}
@@ -0,0 +1,107 @@
+#include "histogram.h"
+#include "task_queue.h"
+#include <iostream>
+
+typedef common::histogram histogram;
+
+//every bucket's upper edge lands in that bucket and the next value in the following one
+bool test_bucket_edges() {
+    bool ok = true;
+    for (uint64_t v = 0; v < histogram::SUB_BUCKETS; v++) {
+        ok = ok && histogram::bucket_of(v) == v && histogram::bucket_upper(v) == v;
+    }
+    for (size_t i = 0; i + 1 < histogram::BUCKETS; i++) {
+        uint64_t upper = histogram::bucket_upper(i);
+        ok = ok && histogram::bucket_of(upper) == i && histogram::bucket_of(upper + 1) == i + 1;
+    }
+    ok = ok && histogram::bucket_upper(histogram::BUCKETS - 1) == UINT64_MAX
+        && histogram::bucket_of(UINT64_MAX) == histogram::BUCKETS - 1;
+    std::cout << "bucket edges: " << ok << std::endl;
+    return ok;
+}
+
+//percentiles never undershoot the true value and overshoot it by at most 1/SUB_BUCKETS
+bool test_percentile_bounds() {
+    bool ok = true;
+    histogram h;
+    ok = ok && h.snap().percentile(0.5) == 0;
+
+    const uint64_t N = 100000;
+    for (uint64_t v = 1; v <= N; v++) {
+        h.record(v);
+    }
+    histogram::snapshot s = h.snap();
+    const double qs[] = { 0.0, 0.1, 0.5, 0.9, 0.99, 0.999 };
+    for (size_t i = 0; i < sizeof(qs) / sizeof(qs[0]); i++) {
+        uint64_t exact = (uint64_t)(qs[i] * N) + 1;
+        uint64_t p = s.percentile(qs[i]);
+        ok = ok && p >= exact && p <= exact + exact / histogram::SUB_BUCKETS;
+    }
+    //the top is clamped to the largest recorded value, not the bucket edge
+    ok = ok && s.percentile(1.0) == N && s.max == N && s.count == N && s.mean() == (N + 1) / 2.0;
+
+    //small values are exact
+    histogram small;
+    for (uint64_t v = 0; v < 10; v++) {
+        small.record(v);
+    }
+    ok = ok && small.snap().percentile(0.5) == 5 && small.snap().percentile(0.0) == 0;
+
+    //merging two halves gives the same snapshot as recording everything in one
+    histogram lo, hi;
+    for (uint64_t v = 1; v <= N; v++) {
+        (v <= N / 2 ? lo : hi).record(v);
+    }
+    histogram::snapshot m = lo.snap();
+    m.merge(hi.snap());
+    ok = ok && m.count == s.count && m.sum == s.sum && m.max == s.max && m.buckets == s.buckets;
+
+    h.reset();
+    ok = ok && h.count() == 0 && h.snap().percentile(0.99) == 0 && h.snap().max == 0;
+    std::cout << "percentile bounds: " << ok << std::endl;
+    return ok;
+}
+
+struct FackTask {
+    int id;
+};
+
+//depth, high water, push/pop counts and one sojourn sample per popped task,
+//plus a wait sample for a pop that blocked until its timeout
+template<typename Queue>
+bool test_queue_stats(Queue &queue, const char *name) {
+    FackTask tasks[10];
+    for (int i = 0; i < 10; i++) {
+        queue.push(&tasks[i]);
+    }
+    for (int i = 0; i < 4; i++) {
+        queue.pop(10);
+    }
+    common::queue_stats::snapshot s = queue.stats().snap();
+    bool ok = s.depth == 6 && s.high_water == 10 && s.pushes == 10 && s.pops == 4 && s.sojourn_ns.count == 4;
+
+    while (queue.try_pop()) {
+    }
+    queue.pop(20);
+    common::queue_stats::snapshot after = queue.stats().snap();
+    ok = ok && after.depth == 0 && after.pops == 10 && after.wait_ns.count == 1
+        && after.wait_ns.max >= 15 * 1000000ull && after.pop_rate(s) > 0;
+    std::cout << name << " stats: depth " << s.depth << ", high water " << s.high_water
+        << ", blocked " << after.wait_ns.max / 1000000 << "ms" << std::endl;
+    return ok;
+}
+
+int main(int argc, char *argv[]) {
+    bool ok = test_bucket_edges();
+    ok = test_percentile_bounds() && ok;
+
+    common::task_queue<FackTask, common::mpmc, common::queue_stats> mpmc;
+    ok = test_queue_stats(mpmc, "mpmc") && ok;
+    common::task_queue<FackTask, common::mpsc, common::queue_stats> mpsc;
+    ok = test_queue_stats(mpsc, "mpsc") && ok;
+    common::task_queue<FackTask, common::spsc, common::queue_stats> spsc(16);
+    ok = test_queue_stats(spsc, "spsc") && ok;
+
+    std::cout << (ok ? "OK" : "FAILED") << std::endl;
+    return ok ? 0 : 1;
+}
@@ -0,0 +1,68 @@
+#include "lockfree_queue.h"
+#include <atomic>
+#include <functional>
+#include <iostream>
+#include <thread>
+
+struct FackTask {
+    uint64_t id;
+    int data;
+};
+
+const int PRODUCER_THREAD_COUNT = 10;
+const int CONSUMER_THREAD_COUNT = 4;
+const int TASKS_PER_PRODUCER = 100000;
+
+std::atomic<uint64_t> consumed(0);
+std::atomic<uint64_t> checksum(0);
+
+void producer_func(common::lockfree_queue<FackTask> *tasks, int index) {
+    for (int i = 0; i < TASKS_PER_PRODUCER; i++) {
+        FackTask *t = new FackTask();
+        t->id = (uint64_t)index * TASKS_PER_PRODUCER + i;
+        t->data = 1;
+        while (!tasks->push(t)) {
+            std::this_thread::yield();
+        }
+    }
+}
+
+void consumer_func(common::lockfree_queue<FackTask> *tasks) {
+    while (consumed.load() < (uint64_t)PRODUCER_THREAD_COUNT * TASKS_PER_PRODUCER) {
+        FackTask *t = tasks->pop(10);
+        if (t) {
+            checksum += t->id;
+            consumed++;
+            delete t;
+        }
+    }
+}
+
+int main(int argc, char *argv[]) {
+    common::lockfree_queue<FackTask> task_queue(1024);
+    std::thread p[PRODUCER_THREAD_COUNT];
+    for (int i = 0; i < PRODUCER_THREAD_COUNT; i++) {
+        p[i] = std::thread(std::bind(producer_func, &task_queue, i));
+    }
+    std::thread c[CONSUMER_THREAD_COUNT];
+    for (int i = 0; i < CONSUMER_THREAD_COUNT; i++) {
+        c[i] = std::thread(std::bind(consumer_func, &task_queue));
+    }
+
+    for (int i = 0; i < PRODUCER_THREAD_COUNT; i++) {
+        p[i].join();
+    }
+    for (int i = 0; i < CONSUMER_THREAD_COUNT; i++) {
+        c[i].join();
+    }
+
+    uint64_t n = (uint64_t)PRODUCER_THREAD_COUNT * TASKS_PER_PRODUCER;
+    uint64_t expect = n * (n - 1) / 2;
+    std::cout << "consumed: " << consumed << ", checksum: " << checksum << ", expect: " << expect << std::endl;
+    if (task_queue.pop(10) != NULL || checksum != expect) {
+        std::cout << "FAILED" << std::endl;
+        return 1;
+    }
+    std::cout << "OK" << std::endl;
+    return 0;
+}
@@ -0,0 +1,96 @@
+#include "priority_task_queue.h"
+#include <atomic>
+#include <iostream>
+#include <thread>
+#include <vector>
+
+struct FackTask {
+    int id;
+};
+
+typedef common::priority_task_queue<FackTask> queue_type;
+
+//pops everything and returns the ids in pop order
+std::vector<int> drain(queue_type &q) {
+    std::vector<int> ids;
+    while (FackTask *t = q.pop(1)) {
+        ids.push_back(t->id);
+        delete t;
+    }
+    return ids;
+}
+
+int main(int argc, char *argv[]) {
+    bool ok = true;
+    queue_type::clock::time_point now = queue_type::clock::now();
+    std::chrono::seconds s(1);
+
+    //priority class first, then earliest deadline, no deadline last, FIFO on ties
+    {
+        queue_type q;
+        q.push(new FackTask{ 6 }, 0);
+        q.push_until(new FackTask{ 5 }, now + 2 * s, 0);
+        q.push_until(new FackTask{ 4 }, now + 1 * s, 0);
+        q.push(new FackTask{ 7 }, 0);
+        q.push_until(new FackTask{ 2 }, now + 9 * s, 5);
+        q.push(new FackTask{ 3 }, 5);
+        q.push(new FackTask{ 1 }, 9);
+        std::vector<int> ids = drain(q);
+        std::vector<int> expect = { 1, 2, 3, 4, 5, 6, 7 };
+        std::cout << "order:";
+        for (size_t i = 0; i < ids.size(); i++) {
+            std::cout << " " << ids[i];
+        }
+        std::cout << std::endl;
+        ok = ok && ids == expect;
+    }
+
+    //expired tasks go to on_expired instead of a worker, the rest still come out
+    {
+        std::vector<int> expired;
+        queue_type q([&](FackTask *t) {
+            expired.push_back(t->id);
+            delete t;
+        });
+        q.push_until(new FackTask{ 1 }, now - s, 9);
+        q.push_until(new FackTask{ 2 }, now + 10 * s, 0);
+        q.push(new FackTask{ 3 }, 0);
+        q.push_until(new FackTask{ 4 }, now - s, 0);
+        std::vector<int> ids = drain(q);
+        std::cout << "expired: " << expired.size() << ", popped: " << ids.size() << std::endl;
+        ok = ok && ids == std::vector<int>({ 2, 3 }) && expired.size() == 2 && q.size() == 0;
+    }
+
+    //only expired tasks queued: pop hands them to on_expired before it blocks
+    {
+        std::atomic<int> expired(0);
+        queue_type q([&](FackTask *t) {
+            expired++;
+            delete t;
+        });
+        q.push_until(new FackTask{ 1 }, now - s, 0);
+        q.push_until(new FackTask{ 2 }, now - s, 5);
+        std::thread consumer([&]() {
+            FackTask *t = q.pop(0);
+            ok = ok && t && t->id == 3;
+            delete t;
+        });
+        for (int i = 0; i < 200 && expired < 2; i++) {
+            std::this_thread::sleep_for(std::chrono::milliseconds(5));
+        }
+        std::cout << "expired while blocked: " << expired << std::endl;
+        ok = ok && expired == 2;
+        q.push(new FackTask{ 3 }, 0);
+        consumer.join();
+    }
+
+    //without a handler nothing is dropped
+    {
+        queue_type q;
+        q.push_until(new FackTask{ 1 }, now - s, 0);
+        ok = ok && drain(q) == std::vector<int>({ 1 });
+    }
+
+    std::cout << (ok ? "OK" : "FAILED") << std::endl;
+    return ok ? 0 : 1;
+}
@@ -0,0 +1,153 @@
+#include "ShardedConnectionPool.h"
+#include <atomic>
+#include <chrono>
+#include <iostream>
+#include <set>
+#include <thread>
+#include <vector>
+#include <functional>
+
+class connection {
+public:
+    connection() : busy(false), reconnects(0), failures(0) {
+    }
+
+    bool reconnect() {
+        reconnects++;
+        //every other repair fails once, the pool has to retry it
+        if (failures < reconnects / 2) {
+            failures++;
+            return false;
+        }
+        return true;
+    }
+
+    std::atomic<bool> busy;
+    std::atomic<int> reconnects;
+    std::atomic<int> failures;
+};
+
+const int THREAD_COUNT = 16;
+const int CONNECTIONS = 4;
+const int ROUNDS = 2000;
+
+std::atomic<int> timeouts(0);
+std::atomic<int> doubled(0);
+std::atomic<int> invalidated(0);
+
+//borrows with a timeout far longer than anyone holds a connection,
+//so a get that comes back empty means a free connection was missed
+void worker_func(common::sharded_connection_pool<connection> *pool, int index) {
+    for (int i = 0; i < ROUNDS; i++) {
+        connection *conn = pool->get(1000);
+        if (!conn) {
+            timeouts++;
+            continue;
+        }
+        if (conn->busy.exchange(true)) {
+            doubled++;
+        }
+        if (i % 8 == 0) {
+            std::this_thread::sleep_for(std::chrono::microseconds(100));
+        }
+        conn->busy.store(false);
+        if ((i + index) % 97 == 0) {
+            invalidated++;
+            pool->mark_invalid(conn);
+        } else {
+            pool->put_back(conn);
+        }
+    }
+}
+
+//takes every connection back out, each one exactly once
+bool all_back(common::sharded_connection_pool<connection> &pool, connection *conns) {
+    std::set<connection *> seen;
+    std::vector<connection *> taken;
+    connection *conn;
+    while (taken.size() < CONNECTIONS && (conn = pool.get(1000))) {
+        seen.insert(conn);
+        taken.push_back(conn);
+    }
+    bool ok = seen.size() == CONNECTIONS && pool.get(50) == NULL;
+    for (int i = 0; i < CONNECTIONS; i++) {
+        ok = ok && seen.count(&conns[i]) == 1;
+    }
+    for (size_t i = 0; i < taken.size(); i++) {
+        pool.put_back(taken[i]);
+    }
+    return ok;
+}
+
+//more threads than connections across shards, slots and the reconnect thread
+bool stress() {
+    common::sharded_connection_pool<connection> pool(4);
+    connection conns[CONNECTIONS];
+    for (int i = 0; i < CONNECTIONS; i++) {
+        pool.add(&conns[i]);
+    }
+    std::vector<std::thread> td;
+    for (int i = 0; i < THREAD_COUNT; i++) {
+        td.push_back(std::thread(std::bind(worker_func, &pool, i)));
+    }
+    for (size_t i = 0; i < td.size(); i++) {
+        td[i].join();
+    }
+    int reconnects = 0;
+    for (int i = 0; i < CONNECTIONS; i++) {
+        reconnects += conns[i].reconnects;
+    }
+    bool back = all_back(pool, conns);
+    std::cout << "stress: timeouts " << timeouts << ", doubled " << doubled << ", invalidated " << invalidated
+        << ", reconnects " << reconnects << ", all back " << (back ? "yes" : "no") << std::endl;
+    return timeouts == 0 && doubled == 0 && invalidated > 0 && reconnects >= invalidated && back;
+}
+
+//a thread blocked on an empty pool gets the connection as soon as it is returned,
+//whether it went into the returning thread's slot or a shard
+bool handoff() {
+    common::sharded_connection_pool<connection> pool(2, false);
+    connection c;
+    pool.add(&c);
+    bool ok = true;
+    for (int i = 0; i < 50 && ok; i++) {
+        connection *held = pool.get(100);
+        long ms = -1;
+        std::thread waiter([&]() {
+            auto start = std::chrono::steady_clock::now();
+            connection *conn = pool.get(1000);
+            ms = (long)std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - start).count();
+            if (conn) {
+                pool.put_back(conn);
+            } else {
+                ms = -1;
+            }
+        });
+        std::this_thread::sleep_for(std::chrono::milliseconds(2));
+        pool.put_back(held);
+        waiter.join();
+        ok = held == &c && ms >= 0 && ms < 500;
+    }
+    std::cout << "handoff: " << (ok ? "ok" : "missed") << std::endl;
+    return ok;
+}
+
+//a connection marked invalid comes back through reconnect to a waiting get
+bool repair() {
+    common::sharded_connection_pool<connection> pool(2);
+    connection c;
+    pool.add(&c);
+    connection *held = pool.get(100);
+    pool.mark_invalid(held);
+    connection *again = pool.get(2000);
+    std::cout << "repair: reconnects " << c.reconnects << std::endl;
+    return held == &c && again == &c && c.reconnects >= 1;
+}
+
+int main(int argc, char *argv[]) {
+    bool ok = stress();
+    ok = handoff() && ok;
+    ok = repair() && ok;
+    std::cout << (ok ? "OK" : "FAILED") << std::endl;
+    return ok ? 0 : 1;
+}
@@ -0,0 +1,118 @@
+#include "task_queue.h"
+#include <atomic>
+#include <iostream>
+#include <thread>
+#include <functional>
+
+struct FackTask {
+    uint64_t id;
+};
+
+const int PRODUCER_THREAD_COUNT = 10;
+const int CONSUMER_THREAD_COUNT = 4;
+const int TASKS_PER_PRODUCER = 10000;
+const size_t CAPACITY = 64;
+
+std::atomic<uint64_t> consumed(0);
+std::atomic<uint64_t> checksum(0);
+
+template<typename Queue>
+void producer_func(Queue *tasks, int index) {
+    for (int i = 0; i < TASKS_PER_PRODUCER; i++) {
+        FackTask *t = new FackTask();
+        t->id = (uint64_t)index * TASKS_PER_PRODUCER + i;
+        if (!tasks->push(t)) {
+            delete t;
+        }
+    }
+}
+
+//keep popping until the queue is closed and drained
+template<typename Queue>
+void consumer_func(Queue *tasks) {
+    while (true) {
+        FackTask *t = tasks->pop(10);
+        if (t) {
+            checksum += t->id;
+            consumed++;
+            delete t;
+        } else if (tasks->is_closed()) {
+            break;
+        }
+    }
+}
+
+template<typename Queue>
+bool run(Queue &queue, int producers, int consumers) {
+    consumed = 0;
+    checksum = 0;
+    std::vector<std::thread> p, c;
+    for (int i = 0; i < producers; i++) {
+        p.push_back(std::thread(std::bind(producer_func<Queue>, &queue, i)));
+    }
+    for (int i = 0; i < consumers; i++) {
+        c.push_back(std::thread(std::bind(consumer_func<Queue>, &queue)));
+    }
+    for (size_t i = 0; i < p.size(); i++) {
+        p[i].join();
+    }
+    queue.close();
+    for (size_t i = 0; i < c.size(); i++) {
+        c[i].join();
+    }
+
+    uint64_t n = (uint64_t)producers * TASKS_PER_PRODUCER;
+    uint64_t expect = n * (n - 1) / 2;
+    FackTask late;
+    std::cout << "consumed: " << consumed << ", checksum: " << checksum << ", expect: " << expect << std::endl;
+    return consumed == n && checksum == expect && !queue.push(&late) && queue.pop(10) == NULL;
+}
+
+//a negative timeout waits forever in both directions, only try_push never waits
+template<typename Queue>
+bool negative_timeout(Queue &full) {
+    FackTask tasks[4], extra;
+    size_t n = 0;
+    while (n < 4 && full.try_push(&tasks[n])) {
+        n++;
+    }
+    std::atomic<bool> pushed(false);
+    std::thread producer([&]() {
+        pushed = full.push(&extra, -1);
+    });
+    std::this_thread::sleep_for(std::chrono::milliseconds(20));
+    bool ok = n < 4 && !pushed && full.pop(-1) == &tasks[0];
+    producer.join();
+    for (size_t i = 1; i < n; i++) {
+        ok = ok && full.pop(-1) == &tasks[i];
+    }
+    return ok && pushed && full.pop(-1) == &extra;
+}
+
+int main(int argc, char *argv[]) {
+    bool ok = true;
+
+    common::task_queue<FackTask> bounded(CAPACITY);
+    ok = run(bounded, PRODUCER_THREAD_COUNT, CONSUMER_THREAD_COUNT) && ok;
+
+    common::task_queue<FackTask, common::mpsc> mpsc;
+    ok = run(mpsc, PRODUCER_THREAD_COUNT, 1) && ok;
+
+    common::task_queue<FackTask, common::spsc> spsc(CAPACITY);
+    ok = run(spsc, 1, 1) && ok;
+
+    //backpressure: a full queue rejects try_push and times out push
+    common::task_queue<FackTask> full(1);
+    FackTask a, b;
+    ok = full.try_push(&a) && !full.try_push(&b) && !full.push(&b, 10) && ok;
+
+    common::task_queue<FackTask> one(1);
+    ok = negative_timeout(one) && ok;
+    common::task_queue<FackTask, common::spsc> ring(1);
+    ok = negative_timeout(ring) && ok;
+    common::task_queue<FackTask, common::spsc> parked(1, true);
+    ok = negative_timeout(parked) && ok;
+
+    std::cout << (ok ? "OK" : "FAILED") << std::endl;
+    return ok ? 0 : 1;
+}
@@ -0,0 +1,120 @@
+#include "task_queue.h"
+#include <functional>
+#include <iostream>
+#include <thread>
+#include <vector>
+
+const int PER_PRODUCER = 50000;
+const int BATCH = 7;
+
+struct FackTask {
+    int producer;
+    int seq;
+};
+
+//pushes PER_PRODUCER tasks, every other run as one push_n batch
+template<typename Queue>
+void produce(Queue &queue, int producer, std::vector<FackTask> &tasks) {
+    tasks.resize(PER_PRODUCER);
+    int i = 0;
+    while (i < PER_PRODUCER) {
+        FackTask *batch[BATCH];
+        int n = 0;
+        for (; n < ((i / BATCH) % 2 ? BATCH : 1) && i < PER_PRODUCER; n++, i++) {
+            tasks[i].producer = producer;
+            tasks[i].seq = i;
+            batch[n] = &tasks[i];
+        }
+        if (n == 1) {
+            queue.push(batch[0]);
+        } else {
+            queue.push_n(batch, n);
+        }
+    }
+}
+
+//pops with pop, pop_n and pop_all in turn until the queue is closed and empty,
+//checks that each producer's tasks arrive once and in order
+template<typename Queue>
+bool consume(Queue &queue, int producers, size_t &received) {
+    std::vector<int> next(producers, 0);
+    std::vector<FackTask *> out;
+    bool ordered = true;
+    for (int round = 0; ; round++) {
+        out.clear();
+        if (round % 3 == 0) {
+            FackTask *t = queue.pop(100);
+            if (t) {
+                out.push_back(t);
+            }
+        } else if (round % 3 == 1) {
+            FackTask *batch[BATCH * 2];
+            size_t n = queue.pop_n(batch, BATCH * 2, 100);
+            out.assign(batch, batch + n);
+        } else {
+            queue.pop_all(out, 100);
+        }
+        if (out.empty() && queue.is_closed()) {
+            break;
+        }
+        for (size_t i = 0; i < out.size(); i++) {
+            ordered = ordered && out[i]->seq == next[out[i]->producer]++;
+        }
+        received += out.size();
+    }
+    return ordered;
+}
+
+template<typename Queue>
+bool run(Queue &queue, int producers, const char *name) {
+    std::vector<std::vector<FackTask> > tasks(producers);
+    size_t received = 0;
+    bool ordered = false;
+    std::thread consumer([&]() {
+        ordered = consume(queue, producers, received);
+    });
+    std::vector<std::thread> p;
+    for (int i = 0; i < producers; i++) {
+        p.push_back(std::thread(produce<Queue>, std::ref(queue), i, std::ref(tasks[i])));
+    }
+    for (size_t i = 0; i < p.size(); i++) {
+        p[i].join();
+    }
+    //whatever is still queued at close must be drained, not dropped
+    queue.close();
+    consumer.join();
+
+    FackTask late = { 0, 0 };
+    size_t expect = (size_t)producers * PER_PRODUCER;
+    std::cout << name << " received: " << received << ", expect: " << expect << ", ordered: " << ordered << std::endl;
+    return ordered && received == expect && queue.size() == 0 && !queue.push(&late) && queue.pop(10) == NULL;
+}
+
+int main(int argc, char *argv[]) {
+    bool ok = true;
+
+    common::task_queue<FackTask, common::mpsc> mpsc;
+    ok = run(mpsc, 4, "mpsc") && ok;
+
+    //a tiny ring keeps the producer blocked on a full queue and wraps many times
+    common::task_queue<FackTask, common::spsc> spsc(8);
+    ok = run(spsc, 1, "spsc") && ok;
+    //same with blocked sides sleeping instead of yielding, no wakeup may be lost
+    common::task_queue<FackTask, common::spsc> parked(8, true);
+    ok = run(parked, 1, "spsc parked") && ok;
+
+    //close with tasks still queued and no consumer running: all of them come out
+    common::task_queue<FackTask, common::spsc> closed(16);
+    FackTask left[5];
+    for (int i = 0; i < 5; i++) {
+        left[i].producer = 0;
+        left[i].seq = i;
+        closed.push(&left[i]);
+    }
+    closed.close();
+    std::vector<FackTask *> out;
+    ok = closed.pop_all(out, 10) == 5 && out[4] == &left[4] && closed.pop(10) == NULL && ok;
+
+    std::cout << (ok ? "OK" : "FAILED") << std::endl;
+    return ok ? 0 : 1;
+}
@@ -1,6 +1,7 @@
 #include "task_queue.h"
 #include <iostream>
 #include <thread>
+#include <functional>
 
 struct FackTask {
     uint64_t id;
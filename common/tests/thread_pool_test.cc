@@ -0,0 +1,38 @@
+#include "thread_pool.h"
+#include <atomic>
+#include <iostream>
+
+std::atomic<uint64_t> leaves(0);
+
+//fan out recursively from inside running tasks
+void spawn(common::thread_pool *pool, int depth) {
+    if (depth == 0) {
+        leaves++;
+        return;
+    }
+    for (int i = 0; i < 4; i++) {
+        pool->submit([pool, depth]() { spawn(pool, depth - 1); });
+    }
+}
+
+int main(int argc, char *argv[]) {
+    common::thread_pool pool(4);
+    const int DEPTH = 8;
+    pool.submit([&pool]() { spawn(&pool, DEPTH); });
+    pool.wait();
+
+    const uint64_t EXTERNAL_TASK_COUNT = 10000;
+    std::atomic<uint64_t> external(0);
+    for (uint64_t i = 0; i < EXTERNAL_TASK_COUNT; i++) {
+        pool.submit([&external]() { external++; });
+    }
+    pool.wait();
+
+    std::cout << "leaves: " << leaves << ", external: " << external << std::endl;
+    if (leaves != (1u << (2 * DEPTH)) || external != EXTERNAL_TASK_COUNT) {
+        std::cout << "FAILED" << std::endl;
+        return 1;
+    }
+    std::cout << "OK" << std::endl;
+    return 0;
+}
@@ -0,0 +1,102 @@
+#include "value_queue.h"
+#include <atomic>
+#include <iostream>
+#include <string>
+#include <thread>
+#include <vector>
+
+std::atomic<int> live(0);
+
+//owns heap memory and counts itself, so a missed destructor or a double one shows up
+struct Task {
+    std::string name;
+    int id;
+
+    Task(int id = -1) : name("task-" + std::to_string(id) + std::string(32, '.')), id(id) {
+        live++;
+    }
+
+    Task(const Task &o) : name(o.name), id(o.id) {
+        live++;
+    }
+
+    Task(Task &&o) : name(std::move(o.name)), id(o.id) {
+        live++;
+    }
+
+    Task &operator=(Task &&o) {
+        name = std::move(o.name);
+        id = o.id;
+        return *this;
+    }
+
+    ~Task() {
+        live--;
+    }
+};
+
+int main(int argc, char *argv[]) {
+    bool ok = true;
+    {
+        common::value_queue<Task> q(4);
+        Task out;
+        int next = 0, expect = 0;
+
+        //keep the ring nearly full while head goes round it many times
+        for (int i = 0; i < 3; i++) {
+            q.push(Task(next++));
+        }
+        for (int round = 0; round < 1000; round++) {
+            q.emplace(next++);
+            ok = ok && q.pop(out, 1) && out.id == expect++ && out.name == "task-" + std::to_string(out.id) + std::string(32, '.');
+        }
+        ok = ok && q.capacity() == 4 && q.size() == 3 && live == 3 + 1;
+
+        //grow while the contents wrap past the end of the ring
+        for (int i = 0; i < 10; i++) {
+            q.emplace(next++);
+        }
+        ok = ok && q.capacity() == 16 && q.size() == 13 && live == 13 + 1;
+        for (int i = 0; i < 5; i++) {
+            ok = ok && q.try_pop(out) && out.id == expect++;
+        }
+        std::cout << "capacity: " << q.capacity() << ", size: " << q.size() << ", live: " << live << std::endl;
+        //leave the rest for the destructor
+    }
+    std::cout << "live after destruction: " << live << std::endl;
+    ok = ok && live == 0;
+
+    //several producers, one consumer: every task arrives once, in order per producer
+    {
+        const int PRODUCERS = 4;
+        const int PER_PRODUCER = 20000;
+        common::value_queue<Task> q(8);
+        std::vector<std::thread> producers;
+        for (int p = 0; p < PRODUCERS; p++) {
+            producers.push_back(std::thread([&q, p]() {
+                for (int i = 0; i < PER_PRODUCER; i++) {
+                    q.emplace(p * PER_PRODUCER + i);
+                }
+            }));
+        }
+        int last[PRODUCERS] = { -1, -1, -1, -1 };
+        Task out;
+        int received = 0;
+        bool ordered = true;
+        while (received < PRODUCERS * PER_PRODUCER && q.pop(out, 1000)) {
+            int p = out.id / PER_PRODUCER;
+            ordered = ordered && out.id > last[p];
+            last[p] = out.id;
+            received++;
+        }
+        for (size_t i = 0; i < producers.size(); i++) {
+            producers[i].join();
+        }
+        std::cout << "received: " << received << ", ordered: " << ordered << std::endl;
+        ok = ok && ordered && received == PRODUCERS * PER_PRODUCER && q.size() == 0;
+    }
+    ok = ok && live == 0;
+
+    std::cout << (ok ? "OK" : "FAILED") << std::endl;
+    return ok ? 0 : 1;
+}
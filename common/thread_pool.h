@@ -0,0 +1,187 @@
+#pragma once
+
+#ifndef __TML_THREAD_POOL_INC__
+#define __TML_THREAD_POOL_INC__
+
+#include <deque>
+#include <mutex>
+#include <atomic>
+#include <memory>
+#include <thread>
+#include <vector>
+#include <cstdint>
+#include <functional>
+#include <condition_variable>
+
+#include "task_queue.h"
+#include "event_count.h"
+
+namespace common {
+
+//work-stealing executor.
+//tasks submitted from a worker go to that worker's own deque and are popped LIFO,
+//idle workers steal FIFO from a random peer. submissions from outside the pool
+//go through a shared task_queue that workers drain when their deque is empty.
+class thread_pool {
+public:
+    typedef std::function<void()> task;
+
+    explicit thread_pool(size_t threads = std::thread::hardware_concurrency()) : pending(0), unfinished(0), stopping(false) {
+        if (threads == 0) {
+            threads = 1;
+        }
+        for (size_t i = 0; i < threads; i++) {
+            workers.emplace_back(new worker());
+            workers[i]->seed = (uint32_t)(i * 2654435761u + 1);
+        }
+        for (size_t i = 0; i < threads; i++) {
+            workers[i]->thread = std::thread(&thread_pool::run, this, i);
+        }
+    }
+
+    thread_pool(const thread_pool &) = delete;
+    thread_pool &operator=(const thread_pool &) = delete;
+
+    //runs all queued tasks, then joins the workers
+    ~thread_pool() {
+        stopping.store(true);
+        wakeup.notify_all();
+        for (size_t i = 0; i < workers.size(); i++) {
+            workers[i]->thread.join();
+        }
+    }
+
+    void submit(task t) {
+        unfinished.fetch_add(1, std::memory_order_relaxed);
+        //counted before it's visible, a thief could otherwise run it and
+        //decrement first, wrapping pending and keeping idle workers spinning.
+        //a worker woken early just finds nothing yet and looks again
+        pending.fetch_add(1, std::memory_order_relaxed);
+        worker *w = current_worker();
+        if (w) {
+            std::unique_lock<std::mutex> lock(w->mutex);
+            w->tasks.push_back(std::move(t));
+        } else {
+            injector.push(new task(std::move(t)));
+        }
+        wakeup.notify_one();
+    }
+
+    //block until every submitted task, including ones spawned by tasks, has run
+    void wait() {
+        std::unique_lock<std::mutex> lock(idle_mutex);
+        while (unfinished.load() != 0) {
+            idle_cond.wait(lock);
+        }
+    }
+
+    size_t size() const {
+        return workers.size();
+    }
+
+private:
+    struct worker {
+        std::mutex mutex;
+        std::deque<task> tasks;
+        std::thread thread;
+        uint32_t seed;
+    };
+
+    struct current {
+        thread_pool *pool;
+        size_t index;
+    };
+
+    static current &this_thread_worker() {
+        static thread_local current c = { NULL, 0 };
+        return c;
+    }
+
+    worker *current_worker() {
+        current &c = this_thread_worker();
+        return c.pool == this ? workers[c.index].get() : NULL;
+    }
+
+    bool pop_local(worker *w, task &t) {
+        std::unique_lock<std::mutex> lock(w->mutex);
+        if (w->tasks.empty()) {
+            return false;
+        }
+        t = std::move(w->tasks.back());
+        w->tasks.pop_back();
+        return true;
+    }
+
+    bool pop_injected(task &t) {
+        task *p = injector.try_pop();
+        if (!p) {
+            return false;
+        }
+        t = std::move(*p);
+        delete p;
+        return true;
+    }
+
+    bool steal(worker *self, task &t) {
+        size_t n = workers.size();
+        //xorshift32, per worker so stealing never shares state
+        uint32_t x = self->seed;
+        x ^= x << 13;
+        x ^= x >> 17;
+        x ^= x << 5;
+        self->seed = x;
+        size_t start = x % n;
+        for (size_t i = 0; i < n; i++) {
+            worker *victim = workers[(start + i) % n].get();
+            if (victim == self) {
+                continue;
+            }
+            std::unique_lock<std::mutex> lock(victim->mutex, std::try_to_lock);
+            if (!lock.owns_lock() || victim->tasks.empty()) {
+                continue;
+            }
+            t = std::move(victim->tasks.front());
+            victim->tasks.pop_front();
+            return true;
+        }
+        return false;
+    }
+
+    void run(size_t index) {
+        current &c = this_thread_worker();
+        c.pool = this;
+        c.index = index;
+        worker *self = workers[index].get();
+        task t;
+        while (true) {
+            if (pop_local(self, t) || pop_injected(t) || steal(self, t)) {
+                pending.fetch_sub(1, std::memory_order_relaxed);
+                t();
+                t = nullptr;
+                if (unfinished.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+                    std::unique_lock<std::mutex> lock(idle_mutex);
+                    idle_cond.notify_all();
+                }
+                continue;
+            }
+            if (stopping.load() && pending.load() == 0) {
+                break;
+            }
+            wakeup.wait([this]() { return pending.load(std::memory_order_acquire) > 0 || stopping.load(); });
+        }
+        c.pool = NULL;
+    }
+
+    std::vector<std::unique_ptr<worker> > workers;
+    task_queue<task> injector;
+    std::atomic<size_t> pending;
+    std::atomic<size_t> unfinished;
+    std::atomic<bool> stopping;
+    event_count wakeup;
+    std::mutex idle_mutex;
+    std::condition_variable idle_cond;
+};
+
+}
+
+#endif //__TML_THREAD_POOL_INC__
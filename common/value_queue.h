@@ -0,0 +1,142 @@
+#pragma once
+
+#ifndef __TML_VALUE_QUEUE_INC__
+#define __TML_VALUE_QUEUE_INC__
+
+#include <mutex>
+#include <chrono>
+#include <memory>
+#include <utility>
+#include <cstddef>
+#include <new>
+#include <type_traits>
+#include <condition_variable>
+
+namespace common {
+
+//task_queue that stores T by value in a preallocated ring.
+//producers move tasks in, consumers move them out, so there is no new/delete per task.
+//the ring only reallocates (doubling) when it outgrows its high-water mark,
+//steady-state push/pop never touch the heap.
+template<typename T>
+class value_queue {
+public:
+    explicit value_queue(size_t capacity = 1024) : slots(NULL), cap(0), head(0), count(0) {
+        grow(capacity < 1 ? 1 : capacity);
+    }
+
+    value_queue(const value_queue &) = delete;
+    value_queue &operator=(const value_queue &) = delete;
+
+    ~value_queue() {
+        clear();
+        delete[] slots;
+    }
+
+    bool push(const T &t) {
+        return emplace(t);
+    }
+
+    bool push(T &&t) {
+        return emplace(std::move(t));
+    }
+
+    template<typename... Args>
+    bool emplace(Args&&... args) {
+        std::unique_lock<std::mutex> lock(mutex);
+        if (count == cap) {
+            grow(cap * 2);
+        }
+        new (&slots[(head + count) % cap]) T(std::forward<Args>(args)...);
+        count++;
+        cond.notify_one();
+        return true;
+    }
+
+    //move the oldest task into out. timeout in ms, <= 0 waits forever.
+    //returns false on timeout
+    bool pop(T &out, int timeout = 0) {
+        std::unique_lock<std::mutex> lock(mutex);
+        auto deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(timeout);
+        while (count == 0) {
+            if (timeout > 0) {
+                if (std::cv_status::timeout == cond.wait_until(lock, deadline)) {
+                    if (count == 0) {
+                        return false;
+                    }
+                    break;
+                }
+            } else {
+                cond.wait(lock);
+            }
+        }
+        take(out);
+        return true;
+    }
+
+    bool try_pop(T &out) {
+        std::unique_lock<std::mutex> lock(mutex);
+        if (count == 0) {
+            return false;
+        }
+        take(out);
+        return true;
+    }
+
+    size_t size() {
+        std::unique_lock<std::mutex> lock(mutex);
+        return count;
+    }
+
+    size_t capacity() {
+        std::unique_lock<std::mutex> lock(mutex);
+        return cap;
+    }
+
+private:
+    typedef typename std::aligned_storage<sizeof(T), alignof(T)>::type slot;
+
+    T *at(size_t i) {
+        return reinterpret_cast<T *>(&slots[(head + i) % cap]);
+    }
+
+    //caller holds the lock and count > 0
+    void take(T &out) {
+        T *t = at(0);
+        out = std::move(*t);
+        t->~T();
+        head = (head + 1) % cap;
+        count--;
+    }
+
+    void grow(size_t n) {
+        slot *fresh = new slot[n];
+        for (size_t i = 0; i < count; i++) {
+            T *t = at(i);
+            new (&fresh[i]) T(std::move(*t));
+            t->~T();
+        }
+        delete[] slots;
+        slots = fresh;
+        cap = n;
+        head = 0;
+    }
+
+    void clear() {
+        for (size_t i = 0; i < count; i++) {
+            at(i)->~T();
+        }
+        count = 0;
+    }
+
+    slot *slots;
+    size_t cap;
+    size_t head;
+    size_t count;
+    std::mutex mutex;
+    std::condition_variable cond;
+};
+
+}
+
+#endif //__TML_VALUE_QUEUE_INC__